@@ -0,0 +1,185 @@
+/**
+ * Compile-time board profiles
+ * One BoardProfile specialization per supported board; the build env selects
+ * it with -DBOARD_PROFILE=BOARD_xxx and every pin class folds to a constant
+ * mask, so nothing on the target has to detect the board at runtime.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include "soc/soc_caps.h"
+
+#define BOARD_S3_N16R8    0           // ESP32-S3, octal flash + octal PSRAM
+#define BOARD_S3_QUAD     1           // ESP32-S3, quad flash, no octal PSRAM
+#define BOARD_ESP32       2           // Classic ESP32 (WROOM, no PSRAM)
+#define BOARD_C3          3           // ESP32-C3
+#define BOARD_C6          4           // ESP32-C6
+
+// Default to the usual module for the target when the env does not say
+#ifndef BOARD_PROFILE
+#if CONFIG_IDF_TARGET_ESP32S3
+#define BOARD_PROFILE     BOARD_S3_N16R8
+#elif CONFIG_IDF_TARGET_ESP32
+#define BOARD_PROFILE     BOARD_ESP32
+#elif CONFIG_IDF_TARGET_ESP32C3
+#define BOARD_PROFILE     BOARD_C3
+#elif CONFIG_IDF_TARGET_ESP32C6
+#define BOARD_PROFILE     BOARD_C6
+#else
+#error "No board profile for this target"
+#endif
+#endif
+
+// A profile built for the wrong chip would secure flash pins: refuse it
+#if (BOARD_PROFILE == BOARD_S3_N16R8 || BOARD_PROFILE == BOARD_S3_QUAD) && !CONFIG_IDF_TARGET_ESP32S3
+#error "BOARD_PROFILE selects an ESP32-S3 board but the target is not ESP32-S3"
+#elif BOARD_PROFILE == BOARD_ESP32 && !CONFIG_IDF_TARGET_ESP32
+#error "BOARD_PROFILE selects a classic ESP32 board but the target is not ESP32"
+#elif BOARD_PROFILE == BOARD_C3 && !CONFIG_IDF_TARGET_ESP32C3
+#error "BOARD_PROFILE selects an ESP32-C3 board but the target is not ESP32-C3"
+#elif BOARD_PROFILE == BOARD_C6 && !CONFIG_IDF_TARGET_ESP32C6
+#error "BOARD_PROFILE selects an ESP32-C6 board but the target is not ESP32-C6"
+#endif
+
+// Bit N of a pin mask = GPIO N, folded at compile time
+constexpr uint64_t pinMask() { return 0; }
+template <typename... Pins>
+constexpr uint64_t pinMask(int pin, Pins... rest) { return (1ULL << pin) | pinMask(rest...); }
+
+// CRITICAL: flash/PSRAM pads, never touched
+// USB_UART: console and USB pads, left alone so the host link survives
+// PULLUP:   strapping pins that must read high on the next reset
+// HEARTBEAT: plain LED driven by LEDC (safe_heartbeat.h), -1 when the board only has an RGB LED
+// DSLEEP_WAKE: pads that can wake the chip from deep sleep (ext0 RTC pads, or deep-sleep GPIO wakeup)
+// PARK_WAKE: default park wake pin (safe_power.h), one of DSLEEP_WAKE
+template <int Profile>
+struct BoardProfile;
+
+template <>
+struct BoardProfile<BOARD_S3_N16R8> {
+  static constexpr const char* CHIP = "ESP32-S3";
+  static constexpr const char* NAME = "S3 N16R8 (octal flash/PSRAM)";
+  static constexpr int MAX_GPIO = 48;
+  static constexpr int BOOT_PIN = 0;
+  static constexpr uint64_t CRITICAL = pinMask(
+    26, 27, 28, 29, 30, 31, 32,  // SPI flash/PSRAM
+    33, 34, 35, 36, 37           // Octal IO4-7, DQS
+  );
+  static constexpr uint64_t USB_UART = pinMask(
+    19, 20,                      // USB D-, D+
+    43, 44                       // U0TXD, U0RXD
+  );
+  static constexpr uint64_t PULLUP = pinMask(0);
+  static constexpr int HEARTBEAT = -1;  // WS2812 on GPIO48
+  static constexpr uint64_t DSLEEP_WAKE = pinMask(
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
+    11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21   // RTC GPIO0-21
+  );
+  static constexpr int PARK_WAKE = 0;   // BOOT button
+};
+
+template <>
+struct BoardProfile<BOARD_S3_QUAD> {
+  static constexpr const char* CHIP = "ESP32-S3";
+  static constexpr const char* NAME = "S3 quad flash (no octal PSRAM)";
+  static constexpr int MAX_GPIO = 48;
+  static constexpr int BOOT_PIN = 0;
+  static constexpr uint64_t CRITICAL = pinMask(
+    26, 27, 28, 29, 30, 31, 32   // SPI flash/PSRAM
+  );
+  static constexpr uint64_t USB_UART = pinMask(
+    19, 20,                      // USB D-, D+
+    43, 44                       // U0TXD, U0RXD
+  );
+  static constexpr uint64_t PULLUP = pinMask(0);
+  static constexpr int HEARTBEAT = -1;  // WS2812 on GPIO48
+  static constexpr uint64_t DSLEEP_WAKE = pinMask(
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
+    11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21   // RTC GPIO0-21
+  );
+  static constexpr int PARK_WAKE = 0;   // BOOT button
+};
+
+template <>
+struct BoardProfile<BOARD_ESP32> {
+  static constexpr const char* CHIP = "ESP32";
+  static constexpr const char* NAME = "ESP32 WROOM";
+  static constexpr int MAX_GPIO = 39;
+  static constexpr int BOOT_PIN = 0;
+  static constexpr uint64_t CRITICAL = pinMask(
+    6, 7, 8, 9, 10, 11           // SPI flash
+  );
+  static constexpr uint64_t USB_UART = pinMask(
+    1, 3                         // U0TXD, U0RXD
+  );
+  static constexpr uint64_t PULLUP = pinMask(0);
+  static constexpr int HEARTBEAT = 2;
+  static constexpr uint64_t DSLEEP_WAKE = pinMask(
+    0, 2, 4, 12, 13, 14, 15, 25, 26, 27,
+    32, 33, 34, 35, 36, 37, 38, 39       // RTC GPIOs
+  );
+  static constexpr int PARK_WAKE = 0;   // BOOT button
+};
+
+template <>
+struct BoardProfile<BOARD_C3> {
+  static constexpr const char* CHIP = "ESP32-C3";
+  static constexpr const char* NAME = "C3";
+  static constexpr int MAX_GPIO = 21;
+  static constexpr int BOOT_PIN = 9;
+  static constexpr uint64_t CRITICAL = pinMask(
+    11,                          // VDD_SPI
+    12, 13, 14, 15, 16, 17       // SPI flash
+  );
+  static constexpr uint64_t USB_UART = pinMask(
+    18, 19,                      // USB D-, D+
+    20, 21                       // U0RXD, U0TXD
+  );
+  static constexpr uint64_t PULLUP = pinMask(9);
+  static constexpr int HEARTBEAT = -1;  // WS2812 on GPIO8
+  static constexpr uint64_t DSLEEP_WAKE = pinMask(
+    0, 1, 2, 3, 4, 5             // Deep-sleep GPIO wakeup (RTC domain)
+  );
+  static constexpr int PARK_WAKE = 3;   // BOOT (GPIO9) cannot wake deep sleep; not a strap pin
+};
+
+template <>
+struct BoardProfile<BOARD_C6> {
+  static constexpr const char* CHIP = "ESP32-C6";
+  static constexpr const char* NAME = "C6";
+  static constexpr int MAX_GPIO = 30;
+  static constexpr int BOOT_PIN = 9;
+  static constexpr uint64_t CRITICAL = pinMask(
+    24, 25, 26, 27, 28, 29, 30   // SPI flash, VDD_SPI
+  );
+  static constexpr uint64_t USB_UART = pinMask(
+    12, 13,                      // USB D-, D+
+    16, 17                       // U0TXD, U0RXD
+  );
+  static constexpr uint64_t PULLUP = pinMask(9);
+  static constexpr int HEARTBEAT = -1;  // WS2812 on GPIO8
+  static constexpr uint64_t DSLEEP_WAKE = pinMask(
+    0, 1, 2, 3, 4, 5, 6, 7       // LP GPIO0-7
+  );
+  static constexpr int PARK_WAKE = 3;   // BOOT (GPIO9) cannot wake deep sleep; not a strap pin
+};
+
+using Board = BoardProfile<BOARD_PROFILE>;
+
+static_assert((Board::CRITICAL & Board::USB_UART) == 0, "critical and USB/UART pins overlap");
+static_assert((Board::CRITICAL & Board::PULLUP) == 0, "critical and pull-up pins overlap");
+static_assert((Board::USB_UART & Board::PULLUP) == 0, "USB/UART and pull-up pins overlap");
+static_assert(Board::MAX_GPIO < SOC_GPIO_PIN_COUNT, "profile walks past the last GPIO");
+
+// Heartbeat pin: the profile's LED unless overridden, -1 = no heartbeat.
+// Excluded from every policy class on purpose, so securing never fights the LEDC output.
+#ifndef HEARTBEAT_PIN
+#define HEARTBEAT_PIN     Board::HEARTBEAT
+#endif
+constexpr uint64_t HEARTBEAT_MASK = (HEARTBEAT_PIN >= 0) ? (1ULL << HEARTBEAT_PIN) : 0;
+
+static_assert((HEARTBEAT_MASK & (Board::CRITICAL | Board::USB_UART | Board::PULLUP)) == 0,
+              "heartbeat pin is a flash, USB/UART or pull-up pin");
+static_assert((HEARTBEAT_MASK & ~(uint64_t)SOC_GPIO_VALID_OUTPUT_GPIO_MASK) == 0,
+              "heartbeat pin cannot drive an output");
\ No newline at end of file
@@ -0,0 +1,26 @@
+/**
+ * Hardware heartbeat
+ * One LEDC channel blinks HEARTBEAT_PIN at a low duty cycle from the RC_FAST
+ * clock, so the LED keeps pulsing through automatic light sleep without a
+ * timer, a task or an interrupt. The pin is outside every policy class
+ * (board_profiles.h); -DHEARTBEAT_PIN=-1 turns the heartbeat off.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include "esp_err.h"
+#include "board_profiles.h"
+
+#ifndef HEARTBEAT_HZ
+#define HEARTBEAT_HZ      2           // Blink rate; 14 bits of RC_FAST cannot go much below 1 Hz
+#endif
+#ifndef HEARTBEAT_PERMILLE
+#define HEARTBEAT_PERMILLE 20         // On-time per period (20 = 10 ms flash at 2 Hz)
+#endif
+#define HEARTBEAT_RESOLUTION 14       // Duty bits, available on every LEDC timer
+
+// ESP_ERR_NOT_SUPPORTED when HEARTBEAT_PIN is -1
+esp_err_t startHeartbeat();
+void stopHeartbeat();                   // Channel idles low: LED off
+bool heartbeatRunning();
\ No newline at end of file
@@ -0,0 +1,59 @@
+/**
+ * Loop latency instrumentation
+ * Always on and cheap enough to stay that way: postEvent() stamps the first
+ * pending event, loop() stamps its wakeup, and every command or event handler
+ * it runs is timed with the cycle counter. Each measurement lands in a log2
+ * histogram (bucket N = under 2^N us), and the longest span is kept with a
+ * tag naming what caused it. Read out with the 'l' command.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+#define LAT_BUCKETS       16          // <1 us ... <16 ms, then everything longer
+#define LAT_CYCLES_MAX_US 1000000     // Longer spans are timed with esp_timer instead
+
+enum LatencyCause : uint8_t {
+  LAT_NONE,
+  LAT_COMMAND,                        // handleCommand(), tag = the command byte
+  LAT_STATUS_TICK,                    // statusTick() on the loop task (single-core chips)
+  LAT_CAUSE_COUNT
+};
+
+struct LatencyHistogram {
+  uint32_t buckets[LAT_BUCKETS];
+  uint32_t count;
+  uint32_t maxUs;
+  uint64_t totalUs;
+};
+
+// Start of a span: cycles for resolution, esp_timer for spans the 32-bit counter would wrap on
+struct LatencyMark {
+  uint32_t cycles;
+  uint32_t us;
+};
+
+struct LatencyStats {
+  LatencyHistogram wake;              // Event posted -> loop() running (includes light-sleep exit)
+  LatencyHistogram iteration;         // loop() wakeup -> back to waiting
+  LatencyHistogram command;           // One handleCommand() call
+  uint32_t lastWakeCycles;            // Cycle counter at the last loop() wakeup
+  uint32_t stallUs;                   // Longest single span seen
+  LatencyCause stallCause;
+  char stallTag;                      // Command byte when stallCause == LAT_COMMAND
+  uint32_t stallAtMs;                 // millis() when it ended
+};
+
+// Any task or callback, before notifying the loop task
+void latencyPosted();
+
+// Loop task only: at wakeup, and around each span
+LatencyMark latencyWoke();
+LatencyMark latencyMark();
+void latencySpan(const LatencyMark& start, LatencyCause cause, char tag = 0);
+void latencyIterationEnd(const LatencyMark& wake);
+
+const LatencyStats& latencyStats();
+void resetLatency();
+int latencyBucketOf(uint32_t us);
\ No newline at end of file
@@ -0,0 +1,99 @@
+/**
+ * Asynchronous event logger
+ * Log calls push fixed-size records into a lock-free ring buffer; a
+ * low-priority FreeRTOS task formats and prints them once the safety
+ * sequence is done, so logging never holds the securing path on the UART.
+ * The task is woken by a notification from each push and otherwise sleeps.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL         2           // 0=Quiet, 1=Normal, 2=Verbose
+#endif
+#define LOG_RING_SIZE     128         // Records in the ring (power of two)
+#define LOG_VERBOSE       2           // Levels >= this are also gated by verboseMode
+
+// Core for background work (log drain, status worker): the one loop() is not on
+#ifndef WORKER_CORE
+#if CONFIG_FREERTOS_UNICORE
+#define WORKER_CORE       0
+#else
+#define WORKER_CORE       (1 - ARDUINO_RUNNING_CORE)
+#endif
+#endif
+
+// Format strings for levels above LOG_LEVEL are compiled out of the image
+#define LOG_TEXT(level, text)  ((level) <= LOG_LEVEL ? (text) : nullptr)
+
+static_assert((LOG_RING_SIZE & (LOG_RING_SIZE - 1)) == 0, "LOG_RING_SIZE must be a power of two");
+
+// Event codes; the drain task maps each one to its format string
+enum LogEvent : uint8_t {
+  EV_SAFETY_BEGIN,
+  EV_SAFETY_ACTIVE,
+  EV_SECURE_BEGIN,
+  EV_SECURE_EARLY,
+  EV_SECURE_DONE,
+  EV_SAFE_AT,
+  EV_PIN_SKIP_INVALID,
+  EV_PIN_SKIP_CRITICAL,
+  EV_PIN_USB_UART,
+  EV_PIN_USB_UART_KEPT,
+  EV_PIN_PULLUP,
+  EV_PIN_PULLDOWN,
+  EV_PIN_HOLD_LOW,
+  EV_PIN_SKIP_POLICY,
+  EV_PIN_HIGHZ,
+  EV_PIN_HEARTBEAT,
+  EV_POLICY_LOADED,
+  EV_POLICY_DEFAULTS,
+  EV_PERIPH_BEGIN,
+  EV_PERIPH_RUNNING,
+  EV_PERIPH_GATED,
+  EV_PERIPH_DONE,
+  EV_IDLE_SLEEP,
+  EV_IDLE_AWAKE,
+  EV_PARK_ENTER,
+  EV_PARK_RESUME,
+  EV_PARK_REFUSED,
+  EV_WARM_RESET,
+  EV_HOST_WAIT,
+  EV_OTA_DONE,
+  EV_OTA_FAIL,
+  EV_NET_OTA_START,
+  EV_NET_OTA_REFUSED,
+  EV_RESIDENT_STAY,
+  EV_RESIDENT_HANDOFF_FAIL,
+  EV_HEARTBEAT_ON,
+  EV_HEARTBEAT_FAIL,
+  EV_COUNT
+};
+
+struct LogRecord {
+  uint32_t timestampUs;               // Low 32 bits of esp_timer_get_time()
+  uint32_t arg;                       // Event-specific value
+  uint8_t level;
+  uint8_t event;
+  int8_t pin;                         // -1 when the event is not about a pin
+};
+
+extern bool verboseMode;               // Runtime switch for LOG_VERBOSE records ('v' command)
+
+// Single producer (the task running setup()/loop()), single consumer (drain task)
+void logPush(uint8_t level, LogEvent event, int pin, uint32_t arg);
+
+// Levels above LOG_LEVEL compile to nothing; verbose levels are filtered at runtime
+template <uint8_t Level>
+inline void logEvent(LogEvent event, int pin = -1, uint32_t arg = 0) {
+  if constexpr (Level <= LOG_LEVEL) {
+    if (Level >= LOG_VERBOSE && !verboseMode) return;
+    logPush(Level, event, pin, arg);
+  }
+}
+
+void startLogDrain();
+void waitLogDrained(uint32_t timeoutMs);
+uint32_t logDroppedCount();
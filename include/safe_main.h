@@ -0,0 +1,29 @@
+/**
+ * Safe-mode entry points
+ * What main.cpp exposes beyond setup()/loop(): the phase timings and the
+ * sequence itself. Under PIO_UNIT_TESTING main.cpp leaves setup()/loop() to
+ * the on-target suite (test/), which runs the same sequence and measures it.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+enum Phase { PHASE_SECURE, PHASE_POLICY, PHASE_PERIPHERALS, PHASE_STATUS, PHASE_COUNT };
+
+struct PhaseTiming {
+  int64_t startUs;                    // esp_timer timestamp at phase entry
+  uint32_t durationUs;                // Duration of the last run
+};
+
+extern PhaseTiming phaseTimings[PHASE_COUNT];
+extern const char* const PHASE_NAMES[PHASE_COUNT];
+extern int64_t safeAtUs;                // esp_timer timestamp at which pins became safe
+extern bool earlySecured;               // Set when the pre-setup() hook already ran
+
+void safeModeSetup();                   // Body of setup(): secure, tear down, report, go idle
+void safeModeLoop();                    // Body of loop(): one batch of events
+void handleCommand(char cmd);
+void showStatus();
+void toggleIdleMode();
+bool pinsVerified();                    // Fresh readback matches the policy
\ No newline at end of file
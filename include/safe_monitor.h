@@ -0,0 +1,26 @@
+/**
+ * External drive detector
+ * Counts edges on secured (high-Z) pins with GPIO interrupts so a peripheral
+ * back-driving a line shows up without any polling. A pin that storms past
+ * MONITOR_STORM_EDGES within one window has its interrupt masked in the ISR.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+#define MONITOR_STORM_EDGES   2000    // Edges per window before a pin is masked
+#define MONITOR_WINDOW_US     100000  // Storm detection window
+
+struct DriveActivity {
+  uint64_t active;                    // Pins with at least one edge since start
+  uint64_t storming;                  // Pins masked for exceeding the storm limit
+  uint64_t levels;                    // Current GPIO_IN levels of the watched pins
+  uint64_t watched;
+};
+
+bool startDriveMonitor(uint64_t pinMask);
+void stopDriveMonitor();
+bool driveMonitorActive();
+DriveActivity driveActivity();
+uint32_t driveToggleCount(int pin);
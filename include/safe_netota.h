@@ -0,0 +1,35 @@
+/**
+ * Wi-Fi OTA endpoint
+ * For boards in enclosures with no USB access: a raw TCP listener that feeds
+ * the same writer pipeline as the serial receiver (safe_ota.h), so erase-ahead,
+ * streaming SHA-256 and the image check apply unchanged. Compiled in only when
+ * OTA_WIFI_SSID is defined, and started from setup() only after the pins have
+ * been secured and verified; the radio never comes up on unsecured pads.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include "esp_err.h"
+
+#ifdef OTA_WIFI_SSID
+#define OTA_WIFI          1
+#else
+#define OTA_WIFI          0           // -DOTA_WIFI_SSID='"..."' -DOTA_WIFI_PASS='"..."' to enable
+#endif
+#ifndef OTA_WIFI_PASS
+#define OTA_WIFI_PASS     ""
+#endif
+#ifndef OTA_TCP_PORT
+#define OTA_TCP_PORT      3233
+#endif
+#define OTA_TCP_STACK     4096
+#define OTA_TCP_PRIORITY  (tskIDLE_PRIORITY + 1)
+
+// Connect the station and start the listener. onDone runs on the listener task
+// after every transfer (otaStats() has the result). ESP_ERR_NOT_SUPPORTED when
+// compiled out.
+esp_err_t startNetOta(void (*onDone)());
+
+bool netOtaStarted();
+uint32_t netOtaAddress();               // IPv4 as in esp_ip4_addr_t, 0 until DHCP completes
\ No newline at end of file
@@ -0,0 +1,66 @@
+/**
+ * Streaming firmware receiver
+ * Takes the real application image over the console link (or Wi-Fi, see
+ * safe_netota.h) while the pins stay secured, so a station needs one
+ * ROM-bootloader upload (safe mode) instead of two. The source fills one chunk
+ * buffer while a writer on WORKER_CORE inflates the other with the ROM's tinfl
+ * and programs the inactive OTA slot. Whenever the writer has nothing queued it
+ * erases sectors ahead of its write cursor, so erase latency hides in the gaps
+ * between chunks. The image is hashed as it is written, and the boot partition
+ * is switched only after the SHA-256 and the full image check both pass.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include "esp_err.h"
+
+#define OTA_CHUNK         4096        // Bytes per acknowledged chunk on the wire
+#define OTA_BUFFERS       2           // One being received, one being written
+#define OTA_WRITER_STACK  4096
+#define OTA_WRITER_PRIORITY (tskIDLE_PRIORITY + 2)
+#define OTA_TIMEOUT_MS    3000        // Longest gap inside a chunk or header
+#define OTA_SECTOR        4096        // Flash erase unit
+#define OTA_ERASE_AHEAD   (16 * OTA_SECTOR)   // How far idle erasing may run past the write cursor
+#ifndef OTA_MAX_BAUD
+#define OTA_MAX_BAUD      921600      // Highest rate a UART host may switch to
+#endif
+
+enum OtaEncoding : uint8_t {
+  OTA_RAW,                            // Image bytes as-is
+  OTA_ZLIB                            // zlib stream (header + deflate + Adler-32)
+};
+
+enum OtaSource : uint8_t {
+  OTA_SRC_NONE,
+  OTA_SRC_SERIAL,
+  OTA_SRC_TCP
+};
+
+struct OtaStats {
+  OtaSource source;                   // Last (or current) transfer
+  uint32_t wireBytes;                 // Received from the host
+  uint32_t imageBytes;                // Written to the slot
+  uint32_t startMs;                   // millis() at otaBegin()
+  uint32_t durationMs;                // otaBegin() to validated image
+  uint32_t baud;                      // Rate used for the data, 0 unless a UART console
+  esp_err_t result;                   // ESP_OK once the slot is bootable
+};
+
+// Writer pipeline, one transfer at a time (ESP_ERR_INVALID_STATE while busy).
+// sha256 is the expected digest of the image (after inflating), or nullptr.
+esp_err_t otaBegin(OtaSource source, uint32_t imageSize, OtaEncoding encoding, const uint8_t* sha256);
+uint8_t* otaAcquire(uint32_t timeoutMs);   // Empty OTA_CHUNK buffer; nullptr on timeout or writer error
+void otaSubmit(uint8_t* buffer, size_t len);
+esp_err_t otaFinish();                  // Drain the writer, validate, switch the boot partition
+void otaAbort();
+const OtaStats& otaStats();
+bool otaBusy();
+esp_err_t otaError();                   // Writer error of the running transfer, ESP_OK while healthy
+uint32_t otaThroughputKBps();           // Wire bytes per second, live while a transfer runs
+
+bool parseSha256(const char* hex, uint8_t* digest);   // 64 hex digits -> 32 bytes
+
+// Console front end ('u' command): the whole exchange, then back to consoleBaud.
+// Nothing else may write to Serial while it runs.
+esp_err_t otaReceiveSerial(uint32_t consoleBaud);
\ No newline at end of file
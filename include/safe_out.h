@@ -0,0 +1,39 @@
+/**
+ * Zero-heap console rendering
+ * Status output is formatted into one statically allocated buffer and handed
+ * to the console TX ring (safe_tx.h) in large chunks. Print::printf() falls back to malloc()
+ * for lines over 64 bytes and String concatenation allocates on every call;
+ * nothing here touches the heap, and each render counts the allocations its
+ * own task makes while it runs so that claim stays checkable in the field.
+ * The count comes from linker wrappers around the heap entry points
+ * (OUT_COUNT_ALLOCS, set for every env in platformio.ini), armed only inside
+ * a render: a malloc/free pair shows up, and no heap walk adds jitter.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+#define OUT_BUFFER_SIZE   1024        // Flushed whenever the next piece does not fit
+#ifndef OUT_COUNT_ALLOCS
+#define OUT_COUNT_ALLOCS  0           // 1 needs the -Wl,--wrap flags from platformio.ini
+#endif
+
+// Brackets nest: only the outermost outEnd() flushes. Serializes the loop task
+// and the status worker, so their reports never interleave.
+void outBegin();
+void outEnd();
+
+void outf(const char* format, ...) __attribute__((format(printf, 1, 2)));
+void outs(const char* text);
+void outln(const char* text = "");    // Same line ending as Serial.println()
+void outRule(char c, int width);      // Horizontal rule, no temporary string
+
+struct OutStats {
+  uint32_t renders;                   // Outermost outBegin()/outEnd() pairs
+  uint32_t lastBytes;                 // Bytes written by the last render
+  int32_t lastAllocs;                 // Allocations by the rendering task in the last render, -1 = not counted
+  uint32_t allocatingRenders;         // Renders that allocated at least once
+};
+
+const OutStats& outStats();
\ No newline at end of file
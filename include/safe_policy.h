@@ -0,0 +1,98 @@
+/**
+ * Runtime pin policy
+ * Per-pin class (high-Z, pull-up, pull-down, hold-low, skip) kept as packed
+ * 3-bit fields in one NVS blob, so which pins on a carrier board get pulls or
+ * are held low can change over serial without a rebuild. The board profile's
+ * flash/PSRAM and USB/UART pins are locked and never follow the table.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include "esp_err.h"
+#include "board_profiles.h"
+
+#define POLICY_NVS_NAMESPACE  "safemode"
+#define POLICY_NVS_KEY        "pins"
+#define POLICY_BITS           3       // Bits per pin in the packed table
+#define POLICY_PINS           64      // Pins covered by the packed table
+#define POLICY_VERSION        1       // Bumped when the blob layout changes
+
+enum PinPolicy : uint8_t {
+  POLICY_HIGHZ,                       // Input, no pulls
+  POLICY_PULLUP,                      // Input, pull-up
+  POLICY_PULLDOWN,                    // Input, pull-down
+  POLICY_HOLD_LOW,                    // Output driven low
+  POLICY_SKIP,                        // Left exactly as found
+  POLICY_COUNT
+};
+
+static_assert(POLICY_COUNT <= (1 << POLICY_BITS), "policy classes do not fit the field");
+
+// One mask per class; a pin is in exactly one of them
+struct PolicyMasks {
+  uint64_t highz;
+  uint64_t pullup;
+  uint64_t pulldown;
+  uint64_t holdLow;
+  uint64_t skip;                      // Includes locked and invalid pins
+  
+  constexpr uint64_t secured() const { return highz | pullup | pulldown | holdLow; }
+};
+
+// Pins the table may reclassify: valid, walked, not locked by the board, not the heartbeat
+constexpr uint64_t POLICY_WALKED_MASK =
+    (Board::MAX_GPIO >= 63) ? ~0ULL : ((1ULL << (Board::MAX_GPIO + 1)) - 1);
+constexpr uint64_t POLICY_EDITABLE_MASK = (uint64_t)SOC_GPIO_VALID_GPIO_MASK & POLICY_WALKED_MASK &
+                                          ~(Board::CRITICAL | Board::USB_UART | HEARTBEAT_MASK);
+
+// No output driver and no pull resistors (classic ESP32 GPIO34-39): high-Z or skip only
+constexpr uint64_t POLICY_INPUT_ONLY_MASK = POLICY_EDITABLE_MASK & ~(uint64_t)SOC_GPIO_VALID_OUTPUT_GPIO_MASK;
+
+static_assert((POLICY_INPUT_ONLY_MASK & Board::PULLUP) == 0, "pull-up pin has no pull resistor");
+
+// Editable pins whose pad can take a class
+constexpr uint64_t policyCapableMask(PinPolicy policy) {
+  return (policy == POLICY_HIGHZ || policy == POLICY_SKIP) ? POLICY_EDITABLE_MASK
+                                                           : POLICY_EDITABLE_MASK & ~POLICY_INPUT_ONLY_MASK;
+}
+
+// Board profile defaults: strapping pins pulled up, everything else high-Z
+constexpr PolicyMasks defaultPolicyMasks() {
+  return {
+    POLICY_EDITABLE_MASK & ~Board::PULLUP,
+    POLICY_EDITABLE_MASK & Board::PULLUP,
+    0,
+    0,
+    ~POLICY_EDITABLE_MASK,
+  };
+}
+
+// Active masks; constant-initialised to the defaults, so valid from global constructors.
+// The reference is for the task that edits the policy (loop task, early hook); every
+// change replaces all five masks at once under a spinlock, and other tasks read them
+// through pinPolicySnapshot() so they never see half an edit.
+const PolicyMasks& pinPolicy();
+PolicyMasks pinPolicySnapshot();
+
+// Replace the defaults with the stored table (one blob read). False if none stored.
+bool loadPinPolicy();
+esp_err_t savePinPolicy();
+esp_err_t erasePinPolicy();
+
+// Take over masks saved earlier (warm reset); locked pins keep their defaults
+void adoptPinPolicy(const PolicyMasks& saved);
+
+PinPolicy pinPolicyOf(int pin);
+PinPolicy pinPolicyOf(const PolicyMasks& masks, int pin);   // Of a snapshot or staged copy
+bool setPinPolicy(int pin, PinPolicy policy);   // False for locked or invalid pins, or a class the pad lacks
+void resetPinPolicy();
+
+// Batch edit: stage pins in a copy of pinPolicy() (same checks as setPinPolicy),
+// then publish the whole batch at once
+bool stagePinPolicy(PolicyMasks* staged, int pin, PinPolicy policy);
+void commitPinPolicy(const PolicyMasks& staged);
+
+// Single-letter names used by the serial editor: z u d l s
+char pinPolicyLetter(PinPolicy policy);
+bool parsePinPolicy(char letter, PinPolicy* policy);
\ No newline at end of file
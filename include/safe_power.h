@@ -0,0 +1,50 @@
+/**
+ * Low-power idle for the secured state
+ * Latches the secured pad configuration with GPIO hold and enables automatic
+ * light sleep, waking on console UART activity or the BOOT button.
+ * Park mode goes further: deep sleep with every secured pad held and the
+ * high-Z RTC pads isolated, so a wakeup needs no re-securing at all. Only some
+ * pads can wake deep sleep (Board::DSLEEP_WAKE), so the park wake pin is per
+ * profile: BOOT on the S3 and classic ESP32, GPIO3 on the C3 and C6.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include "esp_err.h"
+#include "board_profiles.h"
+
+#define IDLE_WAKE_PIN         Board::BOOT_PIN  // BOOT button, active low
+#define IDLE_UART_WAKE_EDGES  3       // RX edges needed to wake from light sleep
+#ifndef PARK_WAKE_PIN
+#define PARK_WAKE_PIN         Board::PARK_WAKE  // Deep-sleep wake pin, active low, pulled up
+#endif
+
+// A park the pin cannot wake from only ends with a power cycle
+static_assert(PARK_WAKE_PIN >= 0 && PARK_WAKE_PIN <= Board::MAX_GPIO &&
+              (Board::DSLEEP_WAKE & (1ULL << PARK_WAKE_PIN)),
+              "PARK_WAKE_PIN cannot wake this chip from deep sleep");
+static_assert(!((Board::CRITICAL | Board::USB_UART | HEARTBEAT_MASK) & (1ULL << PARK_WAKE_PIN)),
+              "PARK_WAKE_PIN is a flash, USB/UART or heartbeat pin");
+#ifdef SOC_GPIO_DEEP_SLEEP_WAKE_VALID_GPIO_MASK
+static_assert((Board::DSLEEP_WAKE & ~(uint64_t)SOC_GPIO_DEEP_SLEEP_WAKE_VALID_GPIO_MASK) == 0,
+              "profile lists a deep-sleep wake pad the SoC does not have");
+#endif
+
+struct IdleState {
+  bool active;                        // Holds latched, wake sources armed
+  bool lightSleep;                    // Automatic light sleep accepted by esp_pm
+  esp_err_t pmError;                  // esp_pm_configure() result
+  uint64_t heldMask;                  // Pins currently held
+};
+
+void enterIdleMode(uint64_t heldMask);
+void exitIdleMode();
+const IdleState& idleState();
+
+// Deep sleep with heldMask latched and isolateMask RTC pads disconnected. Returns
+// only when the wake source cannot be armed, before any pad is held or isolated.
+esp_err_t enterParkMode(uint64_t heldMask, uint64_t isolateMask);
+
+// True when this boot is a deep-sleep wakeup (safe to call from global constructors)
+bool resumedFromPark();
@@ -0,0 +1,55 @@
+/**
+ * Resident safe mode
+ * Built with SAFE_RESIDENT=1 and partitions_safemode.csv, this image lives in
+ * the factory partition next to two OTA slots that hold the application. The
+ * bootloader picks the partition, so a normal boot goes straight to the
+ * application and nothing writes flash. Its factory-reset pin option
+ * (custom_sdkconfig in platformio.ini) is the way in: holding the stay pin low
+ * through reset for CONFIG_BOOTLOADER_HOLD_TIME_GPIO erases otadata, which
+ * boots factory. The pin must stay low over the whole window, so a bounce does
+ * not count, and it is not a strap pin, so holding it through reset does not
+ * enter download mode. Safe mode stays selected across resets until 'g'
+ * selects the application again.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+#include "board_profiles.h"
+
+#ifndef SAFE_RESIDENT
+#define SAFE_RESIDENT     0           // 1 = factory-partition build (see platformio.ini)
+#endif
+
+#if SAFE_RESIDENT
+#if !CONFIG_BOOTLOADER_FACTORY_RESET || !CONFIG_BOOTLOADER_FACTORY_RESET_PIN_LOW
+#error "Resident build needs the bootloader factory-reset pin, active low (custom_sdkconfig in platformio.ini)"
+#endif
+#define RESIDENT_STAY_PIN CONFIG_BOOTLOADER_NUM_PIN_FACTORY_RESET   // Sampled by the bootloader
+static_assert(RESIDENT_STAY_PIN != Board::BOOT_PIN && !(Board::PULLUP & (1ULL << RESIDENT_STAY_PIN)),
+              "stay pin is a strap pin: held through reset it selects the ROM download mode");
+static_assert(!((Board::CRITICAL | Board::USB_UART) & (1ULL << RESIDENT_STAY_PIN)),
+              "stay pin is a flash or USB/UART pin");
+#endif
+
+enum ResidentDecision : uint8_t {
+  RESIDENT_OFF,                       // Not a resident build, or not running from factory
+  RESIDENT_SELECTED,                  // Factory selected: stay pin held through reset, or 'k'
+  RESIDENT_NO_APP,                    // No valid image in an OTA slot
+  RESIDENT_HANDOFF_FAILED             // 'g' could not select the application
+};
+
+// Why this boot runs safe mode; reads the partition table, writes nothing
+ResidentDecision residentDecision();
+
+// Select the application in otadata (one write, on request) and restart into it;
+// returns only on failure
+esp_err_t residentHandoff();
+
+// Select factory (erases otadata), so every reset boots safe mode until a handoff
+esp_err_t residentStay();
+
+// OTA slot holding the application, or nullptr
+const esp_partition_t* residentApp();
\ No newline at end of file
@@ -0,0 +1,25 @@
+/**
+ * Selective peripheral teardown
+ * Reads the peripheral clock-enable/reset state of every LEDC, RMT, I2C, SPI,
+ * UART, MCPWM and I2S unit and only resets and clock-gates the ones that are
+ * actually running, instead of uninstalling drivers that were never installed.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+// Bit N of a unit mask = entry N of the unit table
+uint32_t activePeripheralUnits();
+uint32_t teardownPeripherals(uint32_t keepUnits);
+int peripheralUnitCount();
+const char* peripheralUnitName(int unit);
+
+// Unit mask of the console UART, which teardown must leave running
+uint32_t consoleUartUnit();
+
+// Unit mask of LEDC, kept running while it drives the heartbeat
+uint32_t ledcUnit();
+
+// Route matrix outputs of the given pins back to the simple-GPIO signal
+void detachMatrixOutputs(uint64_t pinMask);
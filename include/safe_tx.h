@@ -0,0 +1,75 @@
+/**
+ * Bounded console transmit
+ * Every console write lands in one statically sized ring and a drain task on
+ * WORKER_CORE hands it to Serial only as fast as Serial.availableForWrite()
+ * allows, so no caller ever blocks on a slow or absent host. When the ring is
+ * full the oldest whole lines are dropped and counted. The JSON status frame
+ * has its own slot: a newer frame replaces an undelivered one, and the last
+ * frame survives any amount of dropped text.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+#ifndef TX_RING_SIZE
+#define TX_RING_SIZE      4096        // Console bytes buffered ahead of the host (power of two)
+#endif
+#define TX_FRAME_SIZE     1024        // Longest status frame, line ending included (asserted)
+#define TX_RETRY_MS       10          // Poll period while the host is not draining
+#define TX_DRAIN_STACK    2560
+#define TX_DRAIN_PRIORITY (tskIDLE_PRIORITY + 1)
+
+static_assert((TX_RING_SIZE & (TX_RING_SIZE - 1)) == 0, "TX_RING_SIZE must be a power of two");
+
+struct TxStats {
+  uint32_t queuedBytes;               // Accepted into the ring
+  uint32_t sentBytes;                 // Handed to Serial
+  uint32_t droppedBytes;              // Pushed out of the ring unsent
+  uint32_t framesReplaced;            // Status frames superseded before they were sent
+  uint32_t peakBytes;                 // Highest ring fill
+};
+
+// Start the drain task; writes before this are buffered
+void txBegin();
+
+// Never blocks; returns len (dropped bytes are counted, not refused)
+size_t txWrite(const uint8_t* data, size_t len);
+
+// Queue frame (no line ending) in the status slot, replacing an unsent one
+void txFrame(const char* frame, size_t len);
+
+// Longest text a frame format can expand to, every conversion at its widest
+// (32-bit long). Only %d/%u/%x with l/ll are sized; anything else never fits.
+constexpr size_t txFormatWorstCase(const char* format) {
+  size_t len = 0;
+  while (*format) {
+    if (*format++ != '%') { len++; continue; }
+    int longs = 0;
+    while (*format == 'l') { longs++; format++; }
+    char conv = *format++;
+    if (conv == '%')      len += 1;
+    else if (conv == 'x') len += longs >= 2 ? 16 : 8;
+    else if (conv == 'u') len += longs >= 2 ? 20 : 10;
+    else if (conv == 'd') len += longs >= 2 ? 20 : 11;
+    else                  return TX_FRAME_SIZE;
+  }
+  return len;
+}
+
+// Wait until everything queued has reached Serial, bounded by timeoutMs
+void txFlush(uint32_t timeoutMs);
+
+// Held: the drain leaves Serial alone (the firmware receiver owns it) and writes keep buffering
+void txHold(bool hold);
+
+const TxStats& txStats();
+
+// Print front end for the console, in place of Serial.print*()
+class ConsoleTx : public Print {
+public:
+  size_t write(uint8_t c) override { return txWrite(&c, 1); }
+  size_t write(const uint8_t* data, size_t len) override { return txWrite(data, len); }
+};
+
+extern ConsoleTx console;
\ No newline at end of file
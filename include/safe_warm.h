@@ -0,0 +1,33 @@
+/**
+ * Warm-reset fast path
+ * A record in RTC_NOINIT memory remembers the last pin policy that was applied
+ * and verified. After a software or watchdog reset, a record whose hash
+ * matches this build lets the early hook apply those masks directly and
+ * setup() go straight to idle, with reporting deferred to the 's' command.
+ * A second record keeps the policy a park latched, so a deep-sleep wakeup can
+ * rewrite the reset-default registers to match the held pads.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include "safe_policy.h"
+
+#define WARM_MAGIC        0x5AFE3A4DUL
+#define PARK_MAGIC        0x5AFE9A4BUL
+
+// Policy to re-apply when this boot is a warm reset with a valid record, else nullptr.
+// Safe to call from global constructors.
+const PolicyMasks* warmResetPolicy();
+
+// Record / forget the policy as applied and verified on this build
+void markWarmReset(const PolicyMasks& masks);
+void clearWarmReset();
+
+// Policy held by the last park on a deep-sleep wakeup with a valid record, else nullptr.
+// Safe to call from global constructors.
+const PolicyMasks* parkedPolicy();
+void markParkedPolicy(const PolicyMasks& masks);
+
+// ROM reset reason of this boot, for reporting
+uint32_t warmResetReason();
\ No newline at end of file
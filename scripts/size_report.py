@@ -0,0 +1,26 @@
+# PlatformIO post-build hook: section sizes, image size and upload time at
+# upload_speed, also written to size_report.json in the build directory so
+# station CI can track the image size per env across commits.
+import json
+import os
+
+Import("env")
+
+
+def size_report(source, target, env):
+    build_dir = env.subst("$BUILD_DIR")
+    elf = os.path.join(build_dir, env.subst("${PROGNAME}.elf"))
+    image = str(target[0])
+    env.Execute(env.VerboseAction('"$SIZETOOL" -A -d "%s"' % elf, "Section sizes"))
+
+    image_bytes = os.path.getsize(image)
+    baud = int(env.GetProjectOption("upload_speed", 115200))
+    upload_s = image_bytes * 10.0 / baud       # 8N1, before esptool's compression
+    print("Image: %d bytes, %.1f s raw at %d baud" % (image_bytes, upload_s, baud))
+
+    with open(os.path.join(build_dir, "size_report.json"), "w") as f:
+        json.dump({"env": env.subst("$PIOENV"), "image_bytes": image_bytes,
+                   "upload_baud": baud, "upload_s_raw": round(upload_s, 2)}, f)
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.bin", size_report)
\ No newline at end of file
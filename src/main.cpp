@@ -1,5 +1,5 @@
 /**
- * ESP32-S3 Safe Mode Flasher
+ * ESP32 Safe Mode Flasher
  * Puts all GPIO pins into safe high-impedance state
  * Prevents damage to peripherals during firmware updates
  * 
@@ -8,286 +8,1665 @@
  */
 
 #include <Arduino.h>
-#include "driver/rmt.h"
-#include <Wire.h>
-#include <SPI.h>
+#include "esp_timer.h"
+#include "esp_cpu.h"
+#include "esp_sleep.h"
+#include "esp_rom_sys.h"
+#include "esp_ipc_isr.h"
+#include "soc/gpio_reg.h"
+#include "soc/gpio_periph.h"
+#include "soc/gpio_sig_map.h"
+#include "soc/io_mux_reg.h"
+#include "soc/soc_caps.h"
+#if SOC_RTCIO_PIN_COUNT > 0 && !SOC_GPIO_SUPPORT_RTC_INDEPENDENT
+#include "soc/rtc_io_periph.h"
+#endif
+#include "board_profiles.h"
+#include "safe_log.h"
+#include "safe_policy.h"
+#include "safe_power.h"
+#include "safe_monitor.h"
+#include "safe_teardown.h"
+#include "safe_warm.h"
+#include "safe_out.h"
+#include "safe_tx.h"
+#include "safe_ota.h"
+#include "safe_netota.h"
+#include "safe_resident.h"
+#include "safe_heartbeat.h"
+#include "safe_main.h"
+#include "safe_latency.h"
 
 // ==================== CONFIGURATION ====================
+#define FW_VERSION        "1.0"
 #define SERIAL_BAUD       115200
-#define LOG_LEVEL         2           // 0=Quiet, 1=Normal, 2=Verbose
-#define SAFETY_DELAY_MS   10          // Delay between pin operations
-
-// System-critical pins (DO NOT MODIFY)
-const int CRITICAL_PINS[] = {
-  22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32,  // External Flash/PSRAM
-  33, 34, 35, 36, 37, 38, 39,                   // SPI/PSRAM interface
-  -1  // End marker
-};
+#define SERIAL_TX_BUFFER  1024        // UART console: driver buffer behind the TX ring (safe_tx.h)
+#define SERIAL_RX_BUFFER  (OTA_CHUNK + 256)   // UART console: a whole firmware chunk while flash writes stall the reader
+#ifndef HOST_WAIT_MS
+#define HOST_WAIT_MS      2000        // USB-CDC: longest wait for the host to open the port
+#endif
+// LOG_LEVEL lives in safe_log.h; override with build_flags = -DLOG_LEVEL=n
+#define SAFETY_DELAY_MS   10          // Delay between pin operations (paced profile only)
+#define STATUS_TICK_MS    30000       // Periodic "still in safe mode" report
+#define COMMAND_LINE_MAX  160         // ':' command lines; longer ones are refused whole
+#define WORKER_STACK      4096        // Status worker on WORKER_CORE (see safe_log.h)
+#define WORKER_PRIORITY   (tskIDLE_PRIORITY + 1)
+#ifndef AUTO_PARK_MIN
+#define AUTO_PARK_MIN     0           // Deep-sleep park after N idle minutes (0 = off)
+#endif
+#ifndef IDLE_MODE_AUTO
+#define IDLE_MODE_AUTO    1           // Hold pins + light sleep once setup() is done
+#endif
+#ifndef SAFE_MINIMAL
+#define SAFE_MINIMAL      0           // 1 = smallest image: no banner art (env esp32-s3-min)
+#endif
 
-// USB/UART pins
-const int USB_UART_PINS[] = {
-  43,  // U0TXD
-  44,  // U0RXD
-  45,  // USB D-
-  46,  // USB D+
-  19,  // USB OTG VN
-  18,  // USB OTG VP
-  -1
-};
+// Classic ESP32: RTC-capable pads take their pulls from RTCIO, IO_MUX FUN_PU/FUN_PD do nothing
+#if SOC_RTCIO_PIN_COUNT > 0 && !SOC_GPIO_SUPPORT_RTC_INDEPENDENT
+#define RTC_PAD_PULLS     1
+#else
+#define RTC_PAD_PULLS     0
+#endif
 
-// Pins that need pull-up resistors
-const int PULLUP_PINS[] = {
-  0,   // GPIO0 (Boot/Download)
-  -1
-};
+#if SAFE_MINIMAL && OTA_WIFI
+#error "SAFE_MINIMAL excludes Wi-Fi: drop OTA_WIFI_SSID from this env"
+#endif
+
+// Securing profile: bulk register stores (default) or legacy paced pinMode walk
+#define SECURE_PROFILE_BULK   0
+#define SECURE_PROFILE_PACED  1
+#ifndef SECURE_PROFILE
+#define SECURE_PROFILE    SECURE_PROFILE_BULK
+#endif
+
+// Pin classes of the board profile picked by the build env (board_profiles.h)
+constexpr int MAX_GPIO = Board::MAX_GPIO;    // Highest GPIO number walked by secureAllPins()
+constexpr uint64_t CRITICAL_MASK = Board::CRITICAL;
+constexpr uint64_t USB_UART_MASK = Board::USB_UART;
+
+// Derived classes fed straight to the bulk register writes
+constexpr uint64_t WALKED_MASK  = (MAX_GPIO >= 63) ? ~0ULL : ((1ULL << (MAX_GPIO + 1)) - 1);
+constexpr uint64_t VALID_MASK   = (uint64_t)SOC_GPIO_VALID_GPIO_MASK & WALKED_MASK;
+constexpr uint64_t SKIPPED_MASK = WALKED_MASK & ~(VALID_MASK & ~CRITICAL_MASK);
+constexpr uint64_t KEPT_MASK    = VALID_MASK & ~CRITICAL_MASK & USB_UART_MASK;
+// Everything else (high-Z, pulls, hold-low, policy skips) comes from pinPolicy():
+// the board defaults until setup() loads the table stored in NVS (safe_policy.h)
 
 // ==================== GLOBALS ====================
 int safePins = 0;
 int skippedPins = 0;
 int specialPins = 0;
-bool verboseMode = true;
+bool verboseMode = true;              // Gates LOG_VERBOSE records at runtime
+int64_t safeAtUs = 0;                 // esp_timer timestamp at which pins became safe
+bool earlySecured = false;            // Set when the pre-setup() hook already ran
+bool parkResumed = false;             // Woke from park: holds already guarantee the state
+bool parkRestored = false;            // Park wakeup re-applied the parked policy (safe_warm.h)
+bool warmBoot = false;                // Warm reset with a matching RTC record (safe_warm.h)
+uint32_t hostWaitMs = 0;              // Time setup() spent waiting for a USB-CDC host
+ResidentDecision residentChoice = RESIDENT_OFF;   // Why a resident build stayed (safe_resident.h)
+esp_err_t handoffError = ESP_OK;
+static const esp_partition_t* residentAppSlot = nullptr;   // Resolved once in residentBoot()
+static const char* const RESIDENT_NAMES[] = {   // Indexed by ResidentDecision
+  "off", "selected (stay pin or 'k')", "stayed (no application)", "handoff failed"
+};
+uint32_t runningUnits = 0;            // Peripheral units found clocked at teardown
+uint32_t gatedUnits = 0;              // Units reset and clock-gated by teardown
+uint32_t glitchCycles = 0;            // First to last pad store of the last quiesce
+uint32_t glitchTicksPerUs = 0;        // CPU clock when glitchCycles was taken
+bool glitchOtherCoreStalled = false;
+int quiesceCore = -1;                 // Core the last quiesce ran on
+
+// ==================== INSTRUMENTATION ====================
+// Phase and PhaseTiming live in safe_main.h, for the on-target suite
+const char* const PHASE_NAMES[PHASE_COUNT] = {
+  "secureAllPins", "loadPinPolicy", "disablePeripherals", "showStatus"
+};
+
+PhaseTiming phaseTimings[PHASE_COUNT] = {};
+
+#if LOG_LEVEL >= 2
+uint32_t pinOpCycles[MAX_GPIO + 1] = {};  // CPU cycles spent securing each pin
+#define PIN_OP_BEGIN()     uint32_t pinOpStart = esp_cpu_get_cycle_count()
+#define PIN_OP_END(pin)    pinOpCycles[pin] = esp_cpu_get_cycle_count() - pinOpStart
+#else
+#define PIN_OP_BEGIN()
+#define PIN_OP_END(pin)
+#endif
+
+inline void phaseBegin(Phase phase) {
+  phaseTimings[phase].startUs = esp_timer_get_time();
+}
+
+inline void phaseEnd(Phase phase) {
+  phaseTimings[phase].durationUs = (uint32_t)(esp_timer_get_time() - phaseTimings[phase].startUs);
+}
 
 // ==================== UTILITIES ====================
-bool isCriticalPin(int pin) {
-  for (int i = 0; CRITICAL_PINS[i] != -1; i++) {
-    if (pin == CRITICAL_PINS[i]) return true;
+inline bool isCriticalPin(int pin) { return CRITICAL_MASK & (1ULL << pin); }
+inline bool isUsbUartPin(int pin)  { return USB_UART_MASK & (1ULL << pin); }
+
+// IO_MUX pull bits the policy wants on a pin
+inline uint32_t policyPull(const PolicyMasks& p, int pin) {
+  uint64_t bit = 1ULL << pin;
+  return (p.pullup & bit) ? FUN_PU : (p.pulldown & bit) ? FUN_PD : 0;
+}
+
+#if RTC_PAD_PULLS
+// RTCIO descriptor of a pad, or nullptr for a digital-only pad
+static inline const rtc_io_desc_t* rtcPad(int pin) {
+  int rtc = rtc_io_num_map[pin];
+  return rtc >= 0 ? &rtc_io_desc[rtc] : nullptr;
+}
+#endif
+
+// Pull bits a pad actually has, as FUN_PU/FUN_PD; mux is its IO_MUX register value
+static inline uint32_t padPull(int pin, uint32_t mux) {
+#if RTC_PAD_PULLS
+  if (const rtc_io_desc_t* rtc = rtcPad(pin)) {
+    uint32_t reg = REG_READ(rtc->reg);
+    return ((reg & rtc->pullup) ? FUN_PU : 0) | ((reg & rtc->pulldown) ? FUN_PD : 0);
   }
-  return false;
+#else
+  (void)pin;
+#endif
+  return mux & (FUN_PU | FUN_PD);
 }
 
-bool isUsbUartPin(int pin) {
-  for (int i = 0; USB_UART_PINS[i] != -1; i++) {
-    if (pin == USB_UART_PINS[i]) return true;
+// Comma-separated GPIO numbers of a mask, for the human-readable status
+void printPinList(uint64_t mask) {
+  outBegin();
+  for (uint64_t m = mask; m; m &= m - 1) {
+    outf("%d%s", __builtin_ctzll(m), (m & (m - 1)) ? "," : "");
   }
-  return false;
+  outEnd();
 }
 
-bool needsPullup(int pin) {
-  for (int i = 0; PULLUP_PINS[i] != -1; i++) {
-    if (pin == PULLUP_PINS[i]) return true;
+// ==================== PIN SAFETY ====================
+// Route a pin to plain GPIO with input enabled and only the wanted pull bits.
+// Registers are read first so pins already in the target state cost no store.
+static inline void muxPinAsInput(int pin, uint32_t pull) {
+#if RTC_PAD_PULLS
+  if (const rtc_io_desc_t* rtc = rtcPad(pin)) {
+    uint32_t cur = REG_READ(rtc->reg);
+    uint32_t want = (cur & ~(rtc->pullup | rtc->pulldown)) |
+                    ((pull & FUN_PU) ? rtc->pullup : 0) | ((pull & FUN_PD) ? rtc->pulldown : 0);
+    if (want != cur) REG_WRITE(rtc->reg, want);
+    pull = 0;                             // Not connected on this pad
+  }
+#endif
+
+  uint32_t muxReg = GPIO_PIN_MUX_REG[pin];
+  if (muxReg) {
+    uint32_t cur = REG_READ(muxReg);
+    uint32_t want = (cur & ~(MCU_SEL_M | FUN_PU | FUN_PD)) |
+                    (PIN_FUNC_GPIO << MCU_SEL_S) | FUN_IE | pull;
+    if (want != cur) REG_WRITE(muxReg, want);
   }
-  return false;
+  
+  uint32_t outSelReg = GPIO_FUNC0_OUT_SEL_CFG_REG + pin * 4;
+  if (REG_READ(outSelReg) != SIG_GPIO_OUT_IDX) REG_WRITE(outSelReg, SIG_GPIO_OUT_IDX);
 }
 
-void logMessage(int level, const char* format, ...) {
-  if (level > LOG_LEVEL) return;
+void secureAllPinsBulk() {
+  const PolicyMasks& policy = pinPolicy();
+  uint64_t secured = policy.secured();
+  
+  // Stop driving every secured pin: output enable and output latch in one store per bank
+  REG_WRITE(GPIO_ENABLE_W1TC_REG, (uint32_t)secured);
+  REG_WRITE(GPIO_OUT_W1TC_REG, (uint32_t)secured);
+#if SOC_GPIO_PIN_COUNT > 32
+  REG_WRITE(GPIO_ENABLE1_W1TC_REG, (uint32_t)(secured >> 32));
+  REG_WRITE(GPIO_OUT1_W1TC_REG, (uint32_t)(secured >> 32));
+#endif
   
-  va_list args;
-  va_start(args, format);
-  char buffer[256];
-  vsnprintf(buffer, sizeof(buffer), format, args);
-  va_end(args);
+  // Detach matrix outputs and fix pulls only where the pad is not already safe
+  for (uint64_t m = secured; m; m &= m - 1) {
+    int pin = __builtin_ctzll(m);
+    PIN_OP_BEGIN();
+    muxPinAsInput(pin, policyPull(policy, pin));
+    PIN_OP_END(pin);
+  }
   
-  Serial.println(buffer);
+  // Hold-low pins: latch is already 0, so enabling the output drives them low
+  if (policy.holdLow) {
+    REG_WRITE(GPIO_ENABLE_W1TS_REG, (uint32_t)policy.holdLow);
+#if SOC_GPIO_PIN_COUNT > 32
+    REG_WRITE(GPIO_ENABLE1_W1TS_REG, (uint32_t)(policy.holdLow >> 32));
+#endif
+  }
 }
 
-// ==================== PIN SAFETY ====================
-void secureAllPins() {
-  logMessage(1, "\n Securing GPIO pins...");
+// ==================== QUIESCE ====================
+// One atomic stage instead of "secure pins, then stop peripherals": with this
+// core's interrupts masked and the other core stalled, clear output enables
+// (so a pad leaving its peripheral lands in high-Z, never GPIO-driven), route
+// every secured pad back to the simple-GPIO signal, fix IO_MUX, then reset and
+// gate the running units. The cycles between first and last store are the
+// bounded glitch window reported in the timing output.
+portMUX_TYPE quiesceLock = portMUX_INITIALIZER_UNLOCKED;
+
+// Callers are pinned: the constructor runs on core 0 before the other core is
+// released, and setup() runs on the loop task pinned to ARDUINO_RUNNING_CORE.
+// The critical section also disables preemption, so the task cannot migrate
+// between deciding to stall the other core and releasing it.
+void quiesce(bool applyPinMasks) {
+  // Before the scheduler runs, the other core is still parked by the startup code
+  bool stallOther = false;
+#if CONFIG_ESP_IPC_ISR_ENABLE
+  stallOther = xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED;
+#endif
   
-  for (int pin = 0; pin <= 48; pin++) {
+  portENTER_CRITICAL(&quiesceLock);
+#if CONFIG_ESP_IPC_ISR_ENABLE
+  if (stallOther) esp_ipc_isr_stall_other_cpu();
+#endif
+  uint32_t start = esp_cpu_get_cycle_count();
+  
+  if (applyPinMasks) {
+    secureAllPinsBulk();
+  } else {
+    detachMatrixOutputs(pinPolicy().secured());
+  }
+  runningUnits |= activePeripheralUnits();
+  gatedUnits |= teardownPeripherals(consoleUartUnit() | (heartbeatRunning() ? ledcUnit() : 0));
+  
+  glitchCycles = esp_cpu_get_cycle_count() - start;
+#if CONFIG_ESP_IPC_ISR_ENABLE
+  if (stallOther) esp_ipc_isr_release_other_cpu();
+#endif
+  portEXIT_CRITICAL(&quiesceLock);
+  
+  glitchTicksPerUs = esp_rom_get_cpu_ticks_per_us();
+  glitchOtherCoreStalled = stallOther;
+  quiesceCore = xPortGetCoreID();
+}
+
+// Park wakeup: the holds still latch the pads, but GPIO, IO_MUX and the matrix
+// are back at reset defaults. Take the policy the park held, so the next quiesce
+// rewrites the registers to match the pads; under the holds that changes nothing
+// at the pins, and releasing a hold later exposes no reset-default pad.
+static void restoreParkedPolicy() {
+  const PolicyMasks* parked = parkedPolicy();
+  if (parked) {
+    adoptPinPolicy(*parked);
+    parkRestored = true;
+  }
+}
+
+#if SECURE_PROFILE != SECURE_PROFILE_PACED
+// Runs from the IDF global-constructor pass, before app_main() starts the Arduino
+// core, so pins are safe long before Serial.begin(). Register stores only: no
+// logging, no FreeRTOS, no heap. Reporting is deferred to secureAllPins().
+__attribute__((constructor(101))) static void secureAllPinsEarly() {
+  if (resumedFromPark()) {
+    restoreParkedPolicy();
+  } else {
+    // Warm reset: the last verified policy, so NVS need not be read again
+    const PolicyMasks* warm = warmResetPolicy();
+    if (warm) {
+      adoptPinPolicy(*warm);
+      warmBoot = true;
+    }
+  }
+  
+  phaseBegin(PHASE_SECURE);
+  quiesce(true);
+  phaseEnd(PHASE_SECURE);
+  safeAtUs = esp_timer_get_time();
+  earlySecured = true;
+}
+#endif
+
+void secureAllPinsPaced() {
+  for (int pin = 0; pin <= MAX_GPIO; pin++) {
     // Skip invalid GPIOs
     if (!GPIO_IS_VALID_GPIO(pin)) {
-      logMessage(2, "  Skip GPIO%02d: Invalid GPIO", pin);
+      logEvent<2>(EV_PIN_SKIP_INVALID, pin);
       skippedPins++;
       continue;
     }
     
     // Handle critical pins
     if (isCriticalPin(pin)) {
-      logMessage(2, "  Skip GPIO%02d: Critical system pin", pin);
+      logEvent<2>(EV_PIN_SKIP_CRITICAL, pin);
+      skippedPins++;
+      continue;
+    }
+    
+    if (HEARTBEAT_MASK & (1ULL << pin)) {
+      logEvent<2>(EV_PIN_HEARTBEAT, pin);
       skippedPins++;
       continue;
     }
     
     // Handle USB/UART pins
     if (isUsbUartPin(pin)) {
+      PIN_OP_BEGIN();
       pinMode(pin, INPUT);
       digitalWrite(pin, LOW);
-      logMessage(2, "  GPIO%02d: INPUT (USB/UART)", pin);
+      PIN_OP_END(pin);
+      logEvent<2>(EV_PIN_USB_UART, pin);
       specialPins++;
       delay(SAFETY_DELAY_MS);
       continue;
     }
     
-    // Handle pull-up required pins
-    if (needsPullup(pin)) {
-      pinMode(pin, INPUT_PULLUP);
-      logMessage(2, "  GPIO%02d: INPUT_PULLUP", pin);
+    PinPolicy policy = pinPolicyOf(pin);
+    if (policy == POLICY_SKIP) {
+      logEvent<2>(EV_PIN_SKIP_POLICY, pin);
+      skippedPins++;
+      continue;
+    }
+    
+    // Handle pull-up/pull-down/hold-low pins
+    if (policy != POLICY_HIGHZ) {
+      PIN_OP_BEGIN();
+      if (policy == POLICY_HOLD_LOW) {
+        digitalWrite(pin, LOW);
+        pinMode(pin, OUTPUT);
+      } else {
+        pinMode(pin, policy == POLICY_PULLUP ? INPUT_PULLUP : INPUT_PULLDOWN);
+      }
+      PIN_OP_END(pin);
+      logEvent<2>(policy == POLICY_PULLUP ? EV_PIN_PULLUP :
+                  policy == POLICY_PULLDOWN ? EV_PIN_PULLDOWN : EV_PIN_HOLD_LOW, pin);
       specialPins++;
       delay(SAFETY_DELAY_MS);
       continue;
     }
     
     // Default: high-impedance input
+    PIN_OP_BEGIN();
     pinMode(pin, INPUT);
     digitalWrite(pin, LOW);  // Ensure no pull-up
-    logMessage(2, "  GPIO%02d: INPUT (High-Z)", pin);
+    PIN_OP_END(pin);
+    logEvent<2>(EV_PIN_HIGHZ, pin);
     safePins++;
     
     delay(SAFETY_DELAY_MS);
   }
+}
+
+void countSecuredPins() {
+  const PolicyMasks& policy = pinPolicy();
+  safePins = __builtin_popcountll(policy.highz);
+  specialPins = __builtin_popcountll(policy.pullup | policy.pulldown | policy.holdLow | KEPT_MASK);
+  skippedPins = __builtin_popcountll(policy.skip & WALKED_MASK & ~KEPT_MASK);
+}
+
+// Per-pin report for the bulk profile, printed after the window is closed
+void reportSecuredPins() {
+  for (int pin = 0; pin <= MAX_GPIO; pin++) {
+    uint64_t bit = 1ULL << pin;
+    if (SKIPPED_MASK & bit) {
+      logEvent<2>(GPIO_IS_VALID_GPIO(pin) ? EV_PIN_SKIP_CRITICAL : EV_PIN_SKIP_INVALID, pin);
+    } else if (USB_UART_MASK & bit) {
+      logEvent<2>(EV_PIN_USB_UART_KEPT, pin);
+    } else if (HEARTBEAT_MASK & bit) {
+      logEvent<2>(EV_PIN_HEARTBEAT, pin);
+    } else {
+      static const LogEvent POLICY_EVENTS[POLICY_COUNT] = {
+        EV_PIN_HIGHZ, EV_PIN_PULLUP, EV_PIN_PULLDOWN, EV_PIN_HOLD_LOW, EV_PIN_SKIP_POLICY
+      };
+      logEvent<2>(POLICY_EVENTS[pinPolicyOf(pin)], pin);
+    }
+  }
   
-  logMessage(1, " All pins secured");
+  countSecuredPins();
+}
+
+// NVS is only up once the Arduino core has started, so the early hook always
+// applies the board defaults; a stored table is then applied on top of them
+// through the same bulk path. Pins only ever move from high-Z to their policy.
+bool loadStoredPolicy() {
+  phaseBegin(PHASE_POLICY);
+  bool stored = loadPinPolicy();
+  phaseEnd(PHASE_POLICY);
+  logEvent<1>(stored ? EV_POLICY_LOADED : EV_POLICY_DEFAULTS, -1,
+              phaseTimings[PHASE_POLICY].durationUs);
+  return stored;
+}
+
+void secureAllPins() {
+  logEvent<1>(EV_SECURE_BEGIN);
+  bool stored = loadStoredPolicy();
+  
+  if (earlySecured) {
+    logEvent<2>(EV_SECURE_EARLY);
+    if (stored) quiesce(true);
+  } else {
+    phaseBegin(PHASE_SECURE);
+#if SECURE_PROFILE == SECURE_PROFILE_PACED
+    // Peripherals off the matrix first, then the slow per-pin walk
+    quiesce(false);
+    secureAllPinsPaced();
+#else
+    quiesce(true);
+#endif
+    phaseEnd(PHASE_SECURE);
+    safeAtUs = esp_timer_get_time();
+  }
+  
+#if SECURE_PROFILE != SECURE_PROFILE_PACED
+  reportSecuredPins();
+#endif
+  
+  logEvent<1>(EV_SECURE_DONE, -1, phaseTimings[PHASE_SECURE].durationUs);
+  logEvent<1>(EV_SAFE_AT, -1, (uint32_t)safeAtUs);
+}
+
+// ==================== VERIFICATION ====================
+// Bulk readback of the secured pads against the policy masks. Costs two bank
+// reads plus two register reads per secured pin, cheap enough for every tick.
+struct VerifyResult {
+  uint64_t driving;                   // Output enable differs from policy (hold-low = on)
+  uint64_t routed;                    // Secured pins muxed to a peripheral, not GPIO
+  uint64_t pullWrong;                 // Pull-up/pull-down bits differ from policy
+  uint64_t pulledLow;                 // Pull-up pins reading low (external drive?)
+  uint64_t levels;                    // GPIO_IN snapshot at verification time
+  uint32_t durationUs;
+  uint32_t runs;
+  uint32_t failures;
+};
+
+// Written by the status worker and by loop() commands; readers get a copy
+VerifyResult lastVerify = {};
+portMUX_TYPE verifyLock = portMUX_INITIALIZER_UNLOCKED;
+
+// Bank-1 registers only exist on chips with more than 32 GPIOs (not C3/C6)
+static inline uint64_t readEnableBanks() {
+#if SOC_GPIO_PIN_COUNT > 32
+  return (uint64_t)REG_READ(GPIO_ENABLE_REG) | ((uint64_t)REG_READ(GPIO_ENABLE1_REG) << 32);
+#else
+  return REG_READ(GPIO_ENABLE_REG);
+#endif
+}
+
+static inline uint64_t readInBanks() {
+#if SOC_GPIO_PIN_COUNT > 32
+  return (uint64_t)REG_READ(GPIO_IN_REG) | ((uint64_t)REG_READ(GPIO_IN1_REG) << 32);
+#else
+  return REG_READ(GPIO_IN_REG);
+#endif
+}
+
+inline bool verifyPassed(const VerifyResult& r) {
+  return !(r.driving | r.routed | r.pullWrong);
+}
+
+VerifyResult verifyPins() {
+  int64_t start = esp_timer_get_time();
+  VerifyResult r = {};
+  PolicyMasks policy = pinPolicySnapshot();   // Runs on the worker too: never half an edit
+  uint64_t secured = policy.secured();
+  
+  uint64_t enabled = readEnableBanks();
+  r.driving = (enabled & secured & ~policy.holdLow) | (policy.holdLow & ~enabled);
+  r.levels = readInBanks();
+  r.pulledLow = policy.pullup & ~r.levels;
+  
+  for (uint64_t m = secured; m; m &= m - 1) {
+    int pin = __builtin_ctzll(m);
+    uint64_t bit = 1ULL << pin;
+    
+    uint32_t mux = REG_READ(GPIO_PIN_MUX_REG[pin]);
+    uint32_t wantPull = policyPull(policy, pin);
+    if (padPull(pin, mux) != wantPull) r.pullWrong |= bit;
+    if (((mux & MCU_SEL_M) >> MCU_SEL_S) != PIN_FUNC_GPIO ||
+        (REG_READ(GPIO_FUNC0_OUT_SEL_CFG_REG + pin * 4) & GPIO_FUNC0_OUT_SEL_M) != SIG_GPIO_OUT_IDX) {
+      r.routed |= bit;
+    }
+  }
+  
+  r.durationUs = (uint32_t)(esp_timer_get_time() - start);
+  
+  portENTER_CRITICAL(&verifyLock);
+  r.runs = lastVerify.runs + 1;
+  r.failures = lastVerify.failures + !verifyPassed(r);
+  lastVerify = r;
+  portEXIT_CRITICAL(&verifyLock);
+  return r;
+}
+
+bool pinsVerified() {
+  return verifyPassed(verifyPins());
+}
+
+// One line when clean; otherwise the failing masks and a per-pin diff
+void printVerify(const VerifyResult& r) {
+  PolicyMasks policy = pinPolicySnapshot();
+  outBegin();
+  if (verifyPassed(r)) {
+    outf("VERIFY OK %d pins (%lu us)%s\n", __builtin_popcountll(policy.secured()),
+         (unsigned long)r.durationUs, r.pulledLow ? " [pull-up pin low]" : "");
+  } else {
+    outf("VERIFY FAIL oe=%llx mux=%llx pull=%llx (%lu us)\n",
+         (unsigned long long)r.driving, (unsigned long long)r.routed,
+         (unsigned long long)r.pullWrong, (unsigned long)r.durationUs);
+    for (uint64_t m = r.driving | r.routed | r.pullWrong; m; m &= m - 1) {
+      int pin = __builtin_ctzll(m);
+      uint64_t bit = 1ULL << pin;
+      outf("  GPIO%02d:%s%s%s\n", pin,
+           (r.driving & bit) ? ((policy.holdLow & bit) ? " not-held-low" : " output-enabled") : "",
+           (r.routed & bit) ? " peripheral-routed" : "",
+           (r.pullWrong & bit) ? " wrong-pull" : "");
+    }
+  }
+  outEnd();
+}
+
+// Remember the policy for the warm-reset path only once the pads verify clean
+void recordWarmState() {
+  if (verifyPassed(verifyPins())) {
+    markWarmReset(pinPolicy());
+  } else {
+    clearWarmReset();
+  }
 }
 
 // ==================== PERIPHERAL SAFETY ====================
+// The quiesce stage already gated everything running at securing time; this
+// sweep catches units started in between (Arduino core init, setup()).
 void disablePeripherals() {
-  logMessage(1, "\n🔌 Disabling peripherals...");
+  phaseBegin(PHASE_PERIPHERALS);
+  logEvent<1>(EV_PERIPH_BEGIN);
+
+  // Only units that are clocked and out of reset get torn down
+  uint32_t late = activePeripheralUnits() & ~consoleUartUnit();
+  if (late) quiesce(false);
+  logEvent<2>(EV_PERIPH_RUNNING, -1, runningUnits);
+  logEvent<2>(EV_PERIPH_GATED, -1, gatedUnits);
+
+  phaseEnd(PHASE_PERIPHERALS);
+  logEvent<1>(EV_PERIPH_DONE, -1, phaseTimings[PHASE_PERIPHERALS].durationUs);
+}
+
+void printUnitNames(uint32_t units) {
+  outBegin();
+  if (!units) outs("none");
+  for (uint32_t m = units; m; m &= m - 1) {
+    outs(peripheralUnitName(__builtin_ctz(m)));
+    if (m & (m - 1)) outs(",");
+  }
+  outEnd();
+}
+
+// ==================== DISPLAY STATUS ====================
+void printTimings() {
+  outBegin();
+  outln("\n TIMING:");
+  for (int p = 0; p < PHASE_COUNT; p++) {
+    outf("   %-20s T+%-10lld %8lu us\n", PHASE_NAMES[p],
+       (long long)phaseTimings[p].startUs, (unsigned long)phaseTimings[p].durationUs);
+  }
+  outf("   %-20s T+%lld us\n", "Safe at", (long long)safeAtUs);
+  outf("   Host wait:         %lu ms\n", (unsigned long)hostWaitMs);
+  outf("   Glitch window:     %lu cycles (%lu us) on core %d, other core %s\n",
+       (unsigned long)glitchCycles,
+       (unsigned long)(glitchTicksPerUs ? glitchCycles / glitchTicksPerUs : 0),
+       quiesceCore, glitchOtherCoreStalled ? "stalled" : "not running");
+  if (otaStats().source != OTA_SRC_NONE) {
+    outf("   Firmware receive:  %lu bytes via %s, %lu ms, %lu KB/s%s (0x%x)\n",
+         (unsigned long)otaStats().imageBytes, otaStats().source == OTA_SRC_TCP ? "Wi-Fi" : "serial",
+         (unsigned long)otaStats().durationMs, (unsigned long)otaThroughputKBps(),
+         otaBusy() ? ", running" : "", (unsigned)otaStats().result);
+  }
+  outf("   Status render:     %lu bytes, %ld allocations (%lu of %lu renders allocated)\n",
+       (unsigned long)outStats().lastBytes, (long)outStats().lastAllocs,
+       (unsigned long)outStats().allocatingRenders, (unsigned long)outStats().renders);
+  outf("   Console TX:        %lu sent, %lu dropped, %lu frames replaced, peak %lu of %d bytes\n",
+       (unsigned long)txStats().sentBytes, (unsigned long)txStats().droppedBytes,
+       (unsigned long)txStats().framesReplaced, (unsigned long)txStats().peakBytes, TX_RING_SIZE);
+  outf("   Free heap:         %lu bytes (min %lu)\n",
+       (unsigned long)ESP.getFreeHeap(), (unsigned long)ESP.getMinFreeHeap());
+  outf("   Loop stack HWM:    %lu bytes free\n",
+       (unsigned long)uxTaskGetStackHighWaterMark(NULL));
+       
+#if LOG_LEVEL >= 2
+  outln("   Per-pin cost (cycles):");
+  for (int pin = 0; pin <= MAX_GPIO; pin++) {
+    if (pinOpCycles[pin]) outf("     GPIO%02d: %lu\n", pin, (unsigned long)pinOpCycles[pin]);
+  }
+#endif
+  outEnd();
+}
+
+// Tasks whose stacks are sized in this firmware, plus the framework's busiest ones
+static const char* const STACK_TASKS[] = {
+  "loopTask", "safeWorker", "logDrain", "txDrain", "otaWriter", "netOta", "esp_timer", "IDLE", "IDLE0", "IDLE1"
+};
+static const char* const LATENCY_CAUSES[LAT_CAUSE_COUNT] = {"none", "command", "status tick"};
+
+static void printHistogram(const char* name, const LatencyHistogram& h) {
+  outf("   %-10s n=%-7lu avg=%-6lu max=%-8lu |", name, (unsigned long)h.count,
+       (unsigned long)(h.count ? h.totalUs / h.count : 0), (unsigned long)h.maxUs);
+  for (int b = 0; b < LAT_BUCKETS; b++) outf(" %lu", (unsigned long)h.buckets[b]);
+  outln();
+}
+
+// 'l': log2 buckets in us, bucket N counts spans under 2^N us, the last one everything longer
+void printLatency() {
+  const LatencyStats& l = latencyStats();
+  outBegin();
+  outln("\n LOOP LATENCY (us; buckets <1 <2 <4 ... <16384, then longer):");
+  printHistogram("Wake", l.wake);
+  printHistogram("Iteration", l.iteration);
+  printHistogram("Command", l.command);
+  if (l.stallCause == LAT_COMMAND) {
+    outf("   Longest stall:     %lu us, command '%c', at %lu ms\n", (unsigned long)l.stallUs,
+         l.stallTag, (unsigned long)l.stallAtMs);
+  } else {
+    outf("   Longest stall:     %lu us, %s, at %lu ms\n", (unsigned long)l.stallUs,
+         LATENCY_CAUSES[l.stallCause], (unsigned long)l.stallAtMs);
+  }
+  outf("   Last wakeup:       cycle %lu\n", (unsigned long)l.lastWakeCycles);
   
-  // Detach PWM from common pins
-  int pwmPins[] = {2, 4, 5, 12, 13, 14, 15, 18, 19, 21, 22, 23, 25, 26, 27, 32, 33};
-  for (int i = 0; i < sizeof(pwmPins)/sizeof(pwmPins[0]); i++) {
-    ledcDetach(pwmPins[i]);
+  outln("\n STACK HIGH-WATER (bytes free):");
+  for (const char* name : STACK_TASKS) {
+    TaskHandle_t task = xTaskGetHandle(name);
+    if (task) outf("   %-18s %lu\n", name, (unsigned long)uxTaskGetStackHighWaterMark(task));
   }
-  logMessage(2, "  PWM detached");
+  outEnd();
+}
+
+// Single-line JSON frame for flashing-station automation ('j' command).
+// 64-bit masks are hex strings so hosts without 64-bit JSON numbers parse them exactly.
+// Sized from the format at compile time, so the frame is never truncated or dropped
+static constexpr char STATUS_FRAME_FORMAT[] =
+  "{\"fw\":\"" FW_VERSION "\",\"up_ms\":%lu,"
+  "\"pins\":{\"safe\":%d,\"special\":%d,\"skipped\":%d},"
+  "\"masks\":{\"hiz\":\"%llx\",\"pu\":\"%llx\",\"pd\":\"%llx\",\"low\":\"%llx\","
+  "\"uart\":\"%llx\",\"skip\":\"%llx\"},"
+  "\"t_us\":{\"secure\":%lu,\"policy\":%lu,\"periph\":%lu,\"status\":%lu,\"safe_at\":%lld},"
+  "\"glitch_cyc\":%lu,"
+  "\"units\":{\"gated\":\"%lx\",\"running\":\"%lx\"},"
+  "\"heap\":{\"free\":%lu,\"min\":%lu,\"status_allocs\":%ld},\"log_drops\":%lu,"
+  "\"idle\":{\"on\":%d,\"sleep\":%d},"
+  "\"verify\":{\"ok\":%d,\"oe\":\"%llx\",\"mux\":\"%llx\",\"pull\":\"%llx\",\"fails\":%lu},"
+  "\"drive\":{\"on\":%d,\"active\":\"%llx\",\"storm\":\"%llx\"},"
+  "\"ota\":{\"src\":%d,\"busy\":%d,\"bytes\":%lu,\"kbps\":%lu,\"err\":%d},"
+  "\"tx\":{\"sent\":%lu,\"dropped\":%lu,\"frames_replaced\":%lu}}";
+static_assert(txFormatWorstCase(STATUS_FRAME_FORMAT) <= TX_FRAME_SIZE - 2,
+              "status frame can outgrow TX_FRAME_SIZE");
+
+void printStatusFrame() {
+  const VerifyResult& verify = verifyPins();
+  DriveActivity drive = driveActivity();
+  PolicyMasks policy = pinPolicy();
+  char frame[TX_FRAME_SIZE - 2];
+  int len = snprintf(frame, sizeof(frame), STATUS_FRAME_FORMAT,
+    millis(),
+    safePins, specialPins, skippedPins,
+    (unsigned long long)policy.highz, (unsigned long long)policy.pullup,
+    (unsigned long long)policy.pulldown, (unsigned long long)policy.holdLow,
+    (unsigned long long)KEPT_MASK, (unsigned long long)(policy.skip & WALKED_MASK & ~KEPT_MASK),
+    (unsigned long)phaseTimings[PHASE_SECURE].durationUs,
+    (unsigned long)phaseTimings[PHASE_POLICY].durationUs,
+    (unsigned long)phaseTimings[PHASE_PERIPHERALS].durationUs,
+    (unsigned long)phaseTimings[PHASE_STATUS].durationUs,
+    (long long)safeAtUs,
+    (unsigned long)glitchCycles,
+    (unsigned long)gatedUnits, (unsigned long)activePeripheralUnits(),
+    (unsigned long)ESP.getFreeHeap(), (unsigned long)ESP.getMinFreeHeap(),
+    (long)outStats().lastAllocs, (unsigned long)logDroppedCount(),
+    idleState().active, idleState().lightSleep,
+    verifyPassed(verify), (unsigned long long)verify.driving, (unsigned long long)verify.routed,
+    (unsigned long long)verify.pullWrong, (unsigned long)verify.failures,
+    drive.watched != 0, (unsigned long long)drive.active, (unsigned long long)drive.storming,
+    (int)otaStats().source, otaBusy(), (unsigned long)otaStats().wireBytes,
+    (unsigned long)otaThroughputKBps(), (int)otaStats().result,
+    (unsigned long)txStats().sentBytes, (unsigned long)txStats().droppedBytes,
+    (unsigned long)txStats().framesReplaced);
   
-  // Uninstall RMT channels (used for WS2812B)
-  for (int ch = 0; ch < 8; ch++) {
-    rmt_driver_uninstall((rmt_channel_t)ch);
+  if (len > 0) txFrame(frame, len);
+}
+
+void showStatus() {
+  phaseBegin(PHASE_STATUS);
+  outBegin();
+  outln();
+  outRule('=', 80);
+  outf("%s SAFE MODE FLASHER\n", Board::CHIP);
+  outRule('=', 80);
+  
+  outf("\n STATUS SUMMARY:\n");
+  outf("   Board profile:     %s\n", Board::NAME);
+  outf("   Safe GPIO pins:    %2d\n", safePins);
+  outf("   Special pins:      %2d\n", specialPins);
+  outf("   Skipped pins:      %2d\n", skippedPins);
+  outf("   Total pins:        %2d\n", safePins + specialPins + skippedPins);
+  outf("   Time to safe:      %lu us\n", (unsigned long)phaseTimings[PHASE_SECURE].durationUs);
+#if SAFE_RESIDENT
+  outf("   Resident:          %s, app %s\n", RESIDENT_NAMES[residentChoice],
+       residentAppSlot ? residentAppSlot->label : "none");
+#endif
+  outf("   Safe since boot:   %lld us%s\n", (long long)safeAtUs,
+       parkResumed ? " (held through park)" : warmBoot ? " (warm reset)" :
+       earlySecured ? " (early hook)" : "");
+  printTimings();
+  
+  outln("\n CURRENT STATE:");
+  const VerifyResult& verify = verifyPins();
+  if (verifyPassed(verify)) {
+    outln("  • Verified: secured GPIOs are undriven inputs on the GPIO matrix");
+    outf("  • Verified: pulls match policy (%d pull-up, %d pull-down, %d held low)\n",
+       __builtin_popcountll(pinPolicy().pullup), __builtin_popcountll(pinPolicy().pulldown),
+       __builtin_popcountll(pinPolicy().holdLow));
+  } else {
+    outs("  • ");
+    printVerify(verify);
   }
-  logMessage(2, "  RMT controllers uninstalled");
+  outs("  • Peripherals gated: ");
+  printUnitNames(gatedUnits);
+  outs(" | still running: ");
+  printUnitNames(activePeripheralUnits());
+  outln();
+  if (idleState().lightSleep) {
+    outln("  • Pins held, automatic light sleep active");
+  } else if (idleState().active) {
+    outf("  • Pins held, light sleep unavailable (esp_pm 0x%x)\n", (unsigned)idleState().pmError);
+  } else {
+    outln("  • Idle mode off (pins not held, CPU awake)");
+  }
+  if (heartbeatRunning()) {
+    outf("  • Heartbeat: GPIO%d, LEDC at %d Hz (no CPU wakeups)\n", HEARTBEAT_PIN, HEARTBEAT_HZ);
+  } else {
+    outln("  • Heartbeat: off");
+  }
+#if OTA_WIFI
+  uint32_t ip = netOtaAddress();
+  if (ip) {
+    outf("  • Wi-Fi OTA listening on %lu.%lu.%lu.%lu:%d\n", (unsigned long)(ip & 0xff),
+         (unsigned long)((ip >> 8) & 0xff), (unsigned long)((ip >> 16) & 0xff), (unsigned long)(ip >> 24),
+         OTA_TCP_PORT);
+  } else {
+    outln(netOtaStarted() ? "  • Wi-Fi OTA: connecting" : "  • Wi-Fi OTA: radio off");
+  }
+#endif
   
-  // Stop I2C
-  Wire.end();
-  logMessage(2, "  I2C stopped");
+  outln("\n NEXT STEPS:");
+  outln("  1. Upload your main firmware");
+  outln("  2. Press RESET button");
+  outln("  3. Or power cycle the board");
   
-  // Stop SPI
-  SPI.end();
-  logMessage(2, "  SPI stopped");
+  outln("\n  WARNING:");
+  outf("  • GPIO%d must stay HIGH for normal boot\n", Board::BOOT_PIN);
+  outs("  • Do not connect anything to USB/UART pins (");
+  printPinList(USB_UART_MASK);
+  outln(")");
+  outs("  • Critical pins (");
+  printPinList(CRITICAL_MASK);
+  outln(") are untouched");
   
-  // Close other serial ports
-  Serial2.end();
-  logMessage(2, "  Serial2 stopped");
+  outRule('=', 80);
+  outln("System is READY for safe programming");
+  outRule('=', 80);
+  outln();
+  outEnd();
+  phaseEnd(PHASE_STATUS);
+}
+
+// ==================== DRIVE MONITOR ====================
+void toggleDriveMonitor() {
+  if (driveMonitorActive()) {
+    stopDriveMonitor();
+    console.println("\nDrive monitor: OFF");
+  } else if (startDriveMonitor(pinPolicy().secured() & ~pinPolicy().holdLow)) {
+    console.printf("\nDrive monitor: ON (%d pins)\n", __builtin_popcountll(driveActivity().watched));
+  } else {
+    console.println("\nDrive monitor: GPIO ISR service unavailable");
+  }
+}
+
+void printDriveActivity() {
+  DriveActivity a = driveActivity();
+  outBegin();
+  if (!a.watched) {
+    outln("DRIVE monitor off ('m' to start)");
+  } else {
+    outf("DRIVE active=%llx storm=%llx level=%llx\n", (unsigned long long)a.active,
+         (unsigned long long)a.storming, (unsigned long long)a.levels);
+    for (uint64_t m = a.active; m; m &= m - 1) {
+      int pin = __builtin_ctzll(m);
+      outf("  GPIO%02d: %lu edges%s\n", pin, (unsigned long)driveToggleCount(pin),
+           (a.storming & (1ULL << pin)) ? " (masked: storm)" : "");
+    }
+  }
+  outEnd();
+}
+
+// ==================== IDLE MODE ====================
+void toggleIdleMode() {
+  if (idleState().active) {
+    exitIdleMode();
+    console.println("\nIdle mode: OFF");
+    return;
+  }
   
-  logMessage(1, " All peripherals disabled");
+  enterIdleMode(pinPolicy().secured());
+  if (idleState().lightSleep) logEvent<1>(EV_IDLE_SLEEP);
+  else                        logEvent<1>(EV_IDLE_AWAKE, -1, (uint32_t)idleState().pmError);
 }
 
-// ==================== DISPLAY STATUS ====================
-void showStatus() {
-  Serial.println("\n" + String(80, '='));
-  Serial.println("ESP32-S3 SAFE MODE FLASHER");
-  Serial.println(String(80, '='));
+// ==================== POLICY EDITOR ====================
+// 'e' switches the console into line mode: "<pin> <z|u|d|l|s>" reclassifies a
+// pin and applies it at once; 'w' stores the table, 'r' restores the board
+// defaults, 'x' erases the stored table, 'q' or an empty line leaves. The first
+// empty line is skipped: a line-buffered monitor sends "e\n", and that newline
+// would otherwise close the editor as it opens.
+bool policyEditing = false;
+bool policyFirstLine = false;         // No line completed since startPolicyEdit()
+char policyLine[24];
+uint8_t policyLineLen = 0;
+
+void printPolicy() {
+  console.println("\nPIN POLICY (z=high-Z u=pull-up d=pull-down l=hold-low s=skip -=locked)");
+  for (int pin = 0; pin <= MAX_GPIO; pin++) {
+    bool locked = !(POLICY_EDITABLE_MASK & (1ULL << pin));
+    console.printf(" %2d:%c", pin, locked ? '-' : pinPolicyLetter(pinPolicyOf(pin)));
+    if (pin % 12 == 11 || pin == MAX_GPIO) console.println();
+  }
+}
+
+// Re-run the bulk securing path with the edited masks. Holds would latch the
+// old pad state, so idle mode is dropped around the stores and re-entered.
+void applyPolicy() {
+  bool held = idleState().active;
+  if (held) exitIdleMode();
+  quiesce(true);
+  countSecuredPins();
+  recordWarmState();
+  if (held) enterIdleMode(pinPolicy().secured());
+}
+
+void runPolicyLine(char* line) {
+  char* end = nullptr;
+  long pin = strtol(line, &end, 10);
+  PinPolicy policy;
   
-  Serial.printf("\n STATUS SUMMARY:\n");
-  Serial.printf("   Safe GPIO pins:    %2d\n", safePins);
-  Serial.printf("   Special pins:      %2d\n", specialPins);
-  Serial.printf("   Skipped pins:      %2d\n", skippedPins);
-  Serial.printf("   Total pins:        %2d\n", safePins + specialPins + skippedPins);
+  if (end != line) {
+    while (*end == ' ') end++;
+    if (!parsePinPolicy(*end, &policy)) {
+      console.println("policy: expected z, u, d, l or s");
+    } else if (!setPinPolicy((int)pin, policy)) {
+      console.printf((POLICY_EDITABLE_MASK & (1ULL << pin)) ? "policy: GPIO%ld is input-only (z or s)\n"
+                                                            : "policy: GPIO%ld is locked by the board profile\n", pin);
+    } else {
+      applyPolicy();
+      console.printf("policy: GPIO%02ld -> %c (not saved)\n", pin, pinPolicyLetter(policy));
+    }
+    return;
+  }
   
-  Serial.println("\n CURRENT STATE:");
-  Serial.println("  • All GPIOs in high-impedance INPUT");
-  Serial.println("  • No pull-up/pull-down resistors active");
-  Serial.println("  • All peripherals (PWM/RMT/I2C/SPI) disabled");
-  Serial.println("  • System in low-power safe state");
+  switch (line[0] | 0x20) {
+    case 'w':
+      console.printf("policy: save %s\n", savePinPolicy() == ESP_OK ? "OK" : "FAILED");
+      break;
+    case 'r':
+      resetPinPolicy();
+      applyPolicy();
+      console.println("policy: board defaults (not saved)");
+      break;
+    case 'x':
+      resetPinPolicy();
+      applyPolicy();
+      console.printf("policy: stored table erase %s\n", erasePinPolicy() == ESP_OK ? "OK" : "FAILED");
+      break;
+    case 'q':
+    case ' ':
+      policyEditing = false;
+      console.println("policy: edit done");
+      break;
+    default:
+      console.println("policy: '<pin> <z|u|d|l|s>', 'w' save, 'r' defaults, 'x' erase, 'q' quit");
+      break;
+  }
+}
+
+void policyEditByte(char c) {
+  if (c == '\r') return;
+  if (c != '\n') {
+    if (policyLineLen < sizeof(policyLine) - 1) policyLine[policyLineLen++] = c;
+    return;
+  }
   
-  Serial.println("\n NEXT STEPS:");
-  Serial.println("  1. Upload your main firmware");
-  Serial.println("  2. Press RESET button");
-  Serial.println("  3. Or power cycle the board");
+  bool first = policyFirstLine;
+  policyFirstLine = false;
+  if (policyLineLen == 0 && first) return;        // The newline after 'e'
   
-  Serial.println("\n  WARNING:");
-  Serial.println("  • GPIO0 must stay HIGH for normal boot");
-  Serial.println("  • Do not connect anything to USB pins (45,46)");
-  Serial.println("  • Critical pins (22-39) are untouched");
+  policyLine[policyLineLen] = '\0';
+  if (policyLineLen == 0) policyLine[0] = ' ';   // Empty line leaves the editor
+  policyLineLen = 0;
+  runPolicyLine(policyLine);
+}
+
+void startPolicyEdit() {
+  printPolicy();
+  console.println("policy: '<pin> <z|u|d|l|s>', 'w' save, 'r' defaults, 'x' erase, 'q' quit");
+  policyEditing = true;
+  policyFirstLine = true;
+  policyLineLen = 0;
+}
+
+// ==================== LINE PROTOCOL ====================
+// For jigs: ':' turns the rest of the line into one command, and its reply is a
+// single render that ends in "OK" or "ERR <reason>". Single keys keep working.
+//   :pin <n>[-<m>]                 PIN <n> <policy> in= oe= <gpio|mux<f>|sig<s>> pull= <ok|BAD|->
+//   :masks                         MASKS and VERIFY lines, hex masks as in 'j'
+//   :set <n>[-<m>]=<z|u|d|l|s> ... whole batch checked, then one bulk pass
+//   :save                          store the table in NVS
+//   :restart                       software reset, back through the warm path
+bool commandLineActive = false;
+char commandLine[COMMAND_LINE_MAX];
+uint8_t commandLineLen = 0;
+bool commandLineOverflow = false;
+
+// Keep the warm-reset record: the early hook re-applies the policy at once
+void restartBoard() {
+  waitLogDrained(500);
+  txFlush(500);
+  Serial.flush();
+  ESP.restart();
+}
+
+// "<n>" or "<n>-<m>" within the walked range; advances *text past it
+bool parsePinRange(const char** text, int* first, int* last) {
+  char* end = nullptr;
+  long a = strtol(*text, &end, 10);
+  if (end == *text) return false;
+  long b = a;
+  if (*end == '-') {
+    const char* second = end + 1;
+    b = strtol(second, &end, 10);
+    if (end == second) return false;
+  }
+  if (a < 0 || b < a || b > MAX_GPIO) return false;
+  *first = (int)a;
+  *last = (int)b;
+  *text = end;
+  return true;
+}
+
+static inline uint64_t rangeMask(int first, int last) {
+  return ((last >= 63) ? ~0ULL : ((1ULL << (last + 1)) - 1)) & ~((1ULL << first) - 1);
+}
+
+void linePin(const char* args) {
+  int first, last;
+  if (!parsePinRange(&args, &first, &last) || *args) {
+    outln("ERR range");
+    return;
+  }
   
-  Serial.println(String(80, '='));
-  Serial.println("System is READY for safe programming");
-  Serial.println(String(80, '=') + "\n");
+  VerifyResult verify = verifyPins();
+  uint64_t enabled = readEnableBanks();
+  PolicyMasks policy = pinPolicySnapshot();
+  uint64_t secured = policy.secured();
+  for (int pin = first; pin <= last; pin++) {
+    uint64_t bit = 1ULL << pin;
+    if (!(VALID_MASK & bit)) {
+      outf("PIN %d - none\n", pin);     // No pad behind this number
+      continue;
+    }
+    
+    uint32_t mux = REG_READ(GPIO_PIN_MUX_REG[pin]);
+    uint32_t func = (mux & MCU_SEL_M) >> MCU_SEL_S;
+    uint32_t signal = REG_READ(GPIO_FUNC0_OUT_SEL_CFG_REG + pin * 4) & GPIO_FUNC0_OUT_SEL_M;
+    char route[8];
+    if (func != PIN_FUNC_GPIO)           snprintf(route, sizeof(route), "mux%lu", (unsigned long)func);
+    else if (signal != SIG_GPIO_OUT_IDX) snprintf(route, sizeof(route), "sig%lu", (unsigned long)signal);
+    else                                 snprintf(route, sizeof(route), "gpio");
+    
+    uint32_t pulls = padPull(pin, mux);
+    const char* pull = (pulls & FUN_PU) ? ((pulls & FUN_PD) ? "ud" : "u") : ((pulls & FUN_PD) ? "d" : "-");
+    const char* state = !(secured & bit) ? "-"
+                      : ((verify.driving | verify.routed | verify.pullWrong) & bit) ? "BAD" : "ok";
+    bool locked = !(POLICY_EDITABLE_MASK & bit);
+    outf("PIN %d %c in=%d oe=%d %s pull=%s %s\n", pin, locked ? '-' : pinPolicyLetter(pinPolicyOf(policy, pin)),
+         (verify.levels & bit) ? 1 : 0, (enabled & bit) ? 1 : 0, route, pull, state);
+  }
+  outln("OK");
+}
+
+void lineMasks() {
+  PolicyMasks p = pinPolicySnapshot();
+  VerifyResult v = verifyPins();
+  outf("MASKS hiz=%llx pu=%llx pd=%llx low=%llx skip=%llx uart=%llx crit=%llx locked=%llx\n",
+       (unsigned long long)p.highz, (unsigned long long)p.pullup, (unsigned long long)p.pulldown,
+       (unsigned long long)p.holdLow, (unsigned long long)p.skip, (unsigned long long)KEPT_MASK,
+       (unsigned long long)CRITICAL_MASK, (unsigned long long)(WALKED_MASK & ~POLICY_EDITABLE_MASK));
+  outf("VERIFY ok=%d oe=%llx mux=%llx pull=%llx low=%llx in=%llx us=%lu runs=%lu fails=%lu\n",
+       verifyPassed(v), (unsigned long long)v.driving, (unsigned long long)v.routed,
+       (unsigned long long)v.pullWrong, (unsigned long long)v.pulledLow, (unsigned long long)v.levels,
+       (unsigned long)v.durationUs, (unsigned long)v.runs, (unsigned long)v.failures);
+  outln("OK");
+}
+
+// All-or-nothing: every spec is parsed and checked before the first pin moves,
+// then the whole batch goes out in one quiesce. A single locked pin is refused;
+// inside a range, locked pins are passed over, as are input-only pads asked for
+// a pull or hold-low.
+void lineSet(const char* args) {
+  struct Spec { uint64_t pins; PinPolicy policy; };
+  Spec specs[MAX_GPIO + 1];
+  int count = 0;
+  
+  while (*args) {
+    const char* token = args;
+    int first, last;
+    PinPolicy policy;
+    if (!parsePinRange(&args, &first, &last) || *args != '=' || !parsePinPolicy(args[1], &policy) ||
+        (args[2] && args[2] != ' ')) {
+      outf("ERR spec %.*s\n", (int)strcspn(token, " "), token);
+      return;
+    }
+    args += 2;
+    while (*args == ' ') args++;
+    
+    uint64_t pins = rangeMask(first, last) & policyCapableMask(policy);
+    if (first == last && !pins) {
+      outf((POLICY_EDITABLE_MASK & (1ULL << first)) ? "ERR input-only %d\n" : "ERR locked %d\n", first);
+      return;
+    }
+    if (count == MAX_GPIO + 1) {
+      outln("ERR too many");
+      return;
+    }
+    specs[count++] = {pins, policy};
+  }
+  if (!count) {
+    outln("ERR empty");
+    return;
+  }
+  
+  // Staged aside and published once, so no reader sees part of the batch
+  PolicyMasks staged = pinPolicy();
+  int changed = 0;
+  for (int i = 0; i < count; i++) {
+    for (uint64_t m = specs[i].pins; m; m &= m - 1) {
+      int pin = __builtin_ctzll(m);
+      if (pinPolicyOf(staged, pin) != specs[i].policy) changed++;
+      stagePinPolicy(&staged, pin, specs[i].policy);
+    }
+  }
+  commitPinPolicy(staged);
+  applyPolicy();
+  outf("OK set=%d verify=%d glitch_us=%lu\n", changed, pinsVerified(),
+       (unsigned long)(glitchTicksPerUs ? glitchCycles / glitchTicksPerUs : 0));
+}
+
+void runCommandLine(char* line) {
+  char* args = line;
+  while (*args && *args != ' ') args++;
+  if (*args) *args++ = '\0';
+  while (*args == ' ') args++;
+  
+  bool restart = !commandLineOverflow && !strcmp(line, "restart");
+  outBegin();
+  if (commandLineOverflow)           outln("ERR too long");
+  else if (!strcmp(line, "pin"))     linePin(args);
+  else if (!strcmp(line, "masks"))   lineMasks();
+  else if (!strcmp(line, "set"))     lineSet(args);
+  else if (!strcmp(line, "save"))    outln(savePinPolicy() == ESP_OK ? "OK" : "ERR nvs");
+  else if (restart)                  outln("OK");
+  else                               outf("ERR unknown %s\n", line);
+  outEnd();
+  
+  if (restart) restartBoard();
+}
+
+void commandLineByte(char c) {
+  if (c == '\r') return;
+  if (c != '\n') {
+    if (commandLineLen < sizeof(commandLine) - 1) commandLine[commandLineLen++] = c;
+    else commandLineOverflow = true;
+    return;
+  }
+  
+  commandLine[commandLineLen] = '\0';
+  commandLineActive = false;
+  runCommandLine(commandLine);
+  commandLineLen = 0;
+  commandLineOverflow = false;
+}
+
+// ==================== HOST LINK ====================
+// The pins are safe long before setup(), so the only reason to wait is to not
+// lose the banner. A UART console never waits: output goes into the TX buffer
+// and drains while setup() continues. A USB-CDC console waits for the host's
+// connection event, bounded by HOST_WAIT_MS, and not at all without a cable.
+#if ARDUINO_USB_CDC_ON_BOOT
+static TaskHandle_t hostWaiter = nullptr;
+
+static void onHostConnected(void*, esp_event_base_t, int32_t, void*) {
+  TaskHandle_t waiter = hostWaiter;
+  if (waiter) xTaskNotifyGive(waiter);
+}
+#endif
+
+uint32_t waitForHost() {
+#if ARDUINO_USB_CDC_ON_BOOT
+  uint32_t start = millis();
+#if ARDUINO_USB_MODE
+  if (!Serial.isPlugged()) {
+    Serial.setTxTimeoutMs(0);             // Nobody to read it: drop, never block
+    return 0;
+  }
+  Serial.onEvent(ARDUINO_HW_CDC_CONNECTED_EVENT, onHostConnected);
+#else
+  Serial.onEvent(ARDUINO_USB_CDC_CONNECTED_EVENT, onHostConnected);
+#endif
+  
+  hostWaiter = xTaskGetCurrentTaskHandle();
+  if (!Serial) ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(HOST_WAIT_MS));
+  hostWaiter = nullptr;
+  ulTaskNotifyTake(pdTRUE, 0);            // Leave the notification value clean for loop()
+#if ARDUINO_USB_MODE
+  if (!Serial) Serial.setTxTimeoutMs(0);
+#endif
+  return millis() - start;
+#else
+  return 0;
+#endif
+}
+
+// ==================== EVENTS ====================
+// Notification bits posted to the loop task; loop() sleeps until one arrives
+#define EVT_SERIAL_RX     (1UL << 0)
+#define EVT_STATUS_TICK   (1UL << 2)
+#define EVT_AUTO_PARK     (1UL << 3)
+#define EVT_OTA_DONE      (1UL << 4)  // Wi-Fi transfer finished (result in otaStats())
+
+// Formatting-heavy events go to the worker on the other core when there is one
+#define EVT_WORKER_MASK   EVT_STATUS_TICK
+
+TaskHandle_t loopTaskHandle = nullptr;
+TaskHandle_t workerTaskHandle = nullptr;
+esp_timer_handle_t statusTimer = nullptr;
+esp_timer_handle_t autoParkTimer = nullptr;
+
+static void postEvent(uint32_t bits) {
+  if (workerTaskHandle && (bits & EVT_WORKER_MASK)) {
+    xTaskNotify(workerTaskHandle, bits & EVT_WORKER_MASK, eSetBits);
+    bits &= ~EVT_WORKER_MASK;
+  }
+  if (bits && loopTaskHandle) {
+    latencyPosted();
+    xTaskNotify(loopTaskHandle, bits, eSetBits);
+  }
+}
+
+static void onTimerEvent(void* arg) {
+  postEvent((uint32_t)(uintptr_t)arg);
+}
+
+#if ARDUINO_USB_CDC_ON_BOOT
+static void onCdcEvent(void*, esp_event_base_t, int32_t, void*) {
+  postEvent(EVT_SERIAL_RX);
+}
+#endif
+
+static esp_timer_handle_t startPeriodicEvent(const char* name, uint32_t bits, uint32_t periodMs) {
+  esp_timer_create_args_t args = {};
+  args.callback = onTimerEvent;
+  args.arg = (void*)(uintptr_t)bits;
+  args.dispatch_method = ESP_TIMER_TASK;
+  args.name = name;
+  args.skip_unhandled_events = true;
+  
+  esp_timer_handle_t timer = nullptr;
+  if (esp_timer_create(&args, &timer) == ESP_OK) {
+    esp_timer_start_periodic(timer, (uint64_t)periodMs * 1000);
+  }
+  return timer;
+}
+
+// Any host activity pushes the auto-park deadline back
+void rearmAutoPark() {
+  if (!autoParkTimer) return;
+  esp_timer_stop(autoParkTimer);
+  esp_timer_start_once(autoParkTimer, (uint64_t)AUTO_PARK_MIN * 60 * 1000000);
+}
+
+void statusTick();
+
+// Periodic verification and status formatting, off the command path
+static void workerTask(void*) {
+  for (;;) {
+    uint32_t events = 0;
+    xTaskNotifyWait(0, UINT32_MAX, &events, portMAX_DELAY);
+    if (events & EVT_STATUS_TICK) statusTick();
+  }
+}
+
+// Single-core chips keep everything on the loop task
+void startWorker() {
+#if WORKER_CORE != ARDUINO_RUNNING_CORE
+  if (workerTaskHandle) return;
+  xTaskCreatePinnedToCore(workerTask, "safeWorker", WORKER_STACK, nullptr, WORKER_PRIORITY,
+                          &workerTaskHandle, WORKER_CORE);
+#endif
+}
+
+// Must run on the loop task (called from setup())
+void startEventSources() {
+  loopTaskHandle = xTaskGetCurrentTaskHandle();
+  
+#if ARDUINO_USB_CDC_ON_BOOT && ARDUINO_USB_MODE
+  Serial.onEvent(ARDUINO_HW_CDC_RX_EVENT, onCdcEvent);
+#elif ARDUINO_USB_CDC_ON_BOOT
+  Serial.onEvent(ARDUINO_USB_CDC_RX_EVENT, onCdcEvent);
+#else
+  Serial.onReceive([]() { postEvent(EVT_SERIAL_RX); });
+#endif
+  
+  statusTimer = startPeriodicEvent("statusTick", EVT_STATUS_TICK, STATUS_TICK_MS);
+
+#if AUTO_PARK_MIN > 0
+  esp_timer_create_args_t args = {};
+  args.callback = onTimerEvent;
+  args.arg = (void*)(uintptr_t)EVT_AUTO_PARK;
+  args.dispatch_method = ESP_TIMER_TASK;
+  args.name = "autoPark";
+  if (esp_timer_create(&args, &autoParkTimer) == ESP_OK) rearmAutoPark();
+#endif
+
+  startWorker();
+  
+  // Serve anything typed before the callbacks were hooked up
+  if (Serial.available()) postEvent(EVT_SERIAL_RX);
+}
+
+// ==================== FIRMWARE RECEIVE ====================
+// 'u' hands the console to the streaming receiver (safe_ota.h); with Wi-Fi OTA
+// built in, a TCP client can do the same at any time (safe_netota.h). The pins
+// stay secured throughout; on success the board restarts into the new image.
+void finishFirmware(esp_err_t err) {
+  if (err != ESP_OK) {
+    logEvent<1>(EV_OTA_FAIL, -1, (uint32_t)err);
+    return;
+  }
+  logEvent<1>(EV_OTA_DONE, -1, otaStats().imageBytes);
+  waitLogDrained(500);
+  txFlush(500);
+  Serial.flush();
+  clearWarmReset();
+  ESP.restart();
+}
+
+void receiveFirmware() {
+  bool held = idleState().active;
+  if (held) exitIdleMode();               // Light sleep would drop bytes mid-chunk
+  if (statusTimer) esp_timer_stop(statusTimer);   // No status ticks inside the protocol
+  waitLogDrained(500);
+  txFlush(500);
+  
+  txHold(true);                           // The receiver owns Serial; output queues meanwhile
+  esp_err_t err = otaReceiveSerial(SERIAL_BAUD);
+  txHold(false);
+  finishFirmware(err);
+  if (statusTimer) esp_timer_start_periodic(statusTimer, (uint64_t)STATUS_TICK_MS * 1000);
+  if (held) enterIdleMode(pinPolicy().secured());
+  rearmAutoPark();
+}
+
+// Runs on the listener task; the result is handled on the loop task
+static void onNetOtaDone() {
+  postEvent(EVT_OTA_DONE);
+}
+
+// The radio comes up last, and only onto pins that verify as secured
+void startWifiOta() {
+#if OTA_WIFI
+  if (!pinsVerified()) {
+    logEvent<1>(EV_NET_OTA_REFUSED);
+    return;
+  }
+  esp_err_t err = startNetOta(onNetOtaDone);
+  if (err == ESP_OK) {
+    logEvent<1>(EV_NET_OTA_START, -1, OTA_TCP_PORT);
+  } else {
+    logEvent<1>(EV_OTA_FAIL, -1, (uint32_t)err);
+  }
+#endif
+}
+
+// ==================== RESIDENT HANDOFF ====================
+// The bootloader already chose this partition (safe_resident.h); a normal boot
+// never gets here, so there is nothing to hand off at start-up, only to report.
+// The slot is resolved once here, not per status render: reading otadata maps
+// flash and allocates. A received image restarts the board, so it stays current.
+void residentBoot() {
+  residentAppSlot = residentApp();
+  if (resumedFromPark()) return;
+  residentChoice = residentDecision();
+  if (residentChoice != RESIDENT_OFF) logEvent<1>(EV_RESIDENT_STAY, -1, residentChoice);
+}
+
+void handoffNow() {
+  if (!SAFE_RESIDENT) {
+    console.println("\nHandoff needs the resident (factory partition) build");
+    return;
+  }
+  console.println("\nHanding off to the application...");
+  waitLogDrained(500);
+  txFlush(500);
+  Serial.flush();
+  handoffError = residentHandoff();     // Returns only on failure
+  residentChoice = RESIDENT_HANDOFF_FAILED;
+  logEvent<1>(EV_RESIDENT_HANDOFF_FAIL, -1, (uint32_t)handoffError);
+}
+
+void stayInSafeMode() {
+  esp_err_t err = residentStay();
+  if (err == ESP_ERR_NOT_SUPPORTED) {
+    console.println("\nStaying needs the resident (factory partition) build");
+  } else if (err != ESP_OK) {
+    console.printf("\nSelecting safe mode failed (0x%x)\n", err);
+  } else {
+    console.println("\nEvery reset now boots safe mode, until 'g'");
+  }
+}
+
+// ==================== HEARTBEAT ====================
+// LEDC blinks the LED from here on (safe_heartbeat.h); loop() never wakes for it.
+// Started after the teardown, which would otherwise gate the channel again.
+void startHeartbeatLed() {
+  if (HEARTBEAT_PIN < 0) return;
+  esp_err_t err = startHeartbeat();
+  if (err == ESP_OK) logEvent<2>(EV_HEARTBEAT_ON, HEARTBEAT_PIN, HEARTBEAT_HZ);
+  else               logEvent<1>(EV_HEARTBEAT_FAIL, HEARTBEAT_PIN, (uint32_t)err);
+}
+
+// ==================== PARK MODE ====================
+void parkBoard() {
+  bool idle = idleState().active;
+  stopHeartbeat();                      // Deep sleep stops LEDC; leave the LED off, not latched
+  logEvent<1>(EV_PARK_ENTER, PARK_WAKE_PIN);
+  waitLogDrained(500);
+  txFlush(500);
+  Serial.flush();
+  markParkedPolicy(pinPolicy());        // What the holds latch, edited or not
+  
+  // Returns only when no wake source could be armed; no pad was held or isolated
+  esp_err_t err = enterParkMode(pinPolicy().secured(), pinPolicy().highz);
+  logEvent<1>(EV_PARK_REFUSED, PARK_WAKE_PIN, (uint32_t)err);
+  startHeartbeatLed();
+  if (idle) toggleIdleMode();
+}
+
+// Software/watchdog reset with a matching record: the early hook already put
+// the pads in the last verified state, so skip the host wait, banner, policy
+// read and status dump. Late units are still swept; reporting waits for 's'.
+void resumeFromWarmReset() {
+  countSecuredPins();
+  startLogDrain();
+  disablePeripherals();
+  logEvent<1>(EV_WARM_RESET, -1, warmResetReason());
+  startHeartbeatLed();
+  startEventSources();
+  recordWarmState();
+  startWifiOta();
+#if IDLE_MODE_AUTO
+  toggleIdleMode();
+#endif
+}
+
+// Deep-sleep wakeup: the holds already guarantee the safe state, so skip the
+// banner and teardown and go straight back to idle. The registers are brought
+// in line with the held pads first, before anything releases a hold or reports.
+void resumeFromPark() {
+#if SECURE_PROFILE == SECURE_PROFILE_PACED
+  restoreParkedPolicy();                // No early hook in this profile
+  if (parkRestored) quiesce(true);
+#endif
+  if (!parkRestored) {                  // No record (other image?): the stored table
+    loadPinPolicy();
+    quiesce(true);
+  }
+  countSecuredPins();
+  startLogDrain();
+  logEvent<1>(EV_PARK_RESUME, -1, (uint32_t)esp_sleep_get_wakeup_cause());
+  startHeartbeatLed();
+  startEventSources();
+  toggleIdleMode();
 }
 
 // ==================== MAIN SETUP ====================
-void setup() {
+void safeModeSetup() {
+#if SAFE_RESIDENT
+  residentBoot();
+#endif
+  
   // Start serial (keep this for monitoring)
+#if !ARDUINO_USB_CDC_ON_BOOT
+  Serial.setTxBufferSize(SERIAL_TX_BUFFER);
+  Serial.setRxBufferSize(SERIAL_RX_BUFFER);
+#endif
   Serial.begin(SERIAL_BAUD);
-  delay(2000);  // Wait for serial connection
+  txBegin();
+  
+  parkResumed = resumedFromPark();
+  if (parkResumed) {
+    resumeFromPark();
+    return;
+  }
+  if (warmBoot) {
+    resumeFromWarmReset();
+    return;
+  }
+  
+  hostWaitMs = waitForHost();
+  logEvent<2>(EV_HOST_WAIT, -1, hostWaitMs);
   
   // Print header
-  Serial.println("\n\n");
-  Serial.println("███████╗███████╗██████╗ ██████╗ ██████╗ ██████╗");
-  Serial.println("██╔════╝██╔════╝██╔══██╗╚════██╗╚════██╗╚════██╗");
-  Serial.println("███████╗███████╗██████╔╝ █████╔╝ █████╔╝ █████╔╝");
-  Serial.println("╚════██║╚════██║██╔═══╝ ██╔═══╝  ╚═══██╗██╔═══╝");
-  Serial.println("███████║███████║██║     ███████╗██████╔╝███████╗");
-  Serial.println("╚══════╝╚══════╝╚═╝     ╚══════╝╚═════╝ ╚══════╝");
-  Serial.println("\n          ESP32-S3 SAFE MODE FLASHER");
-  Serial.println("          v1.0 | MIT License | 2024");
+#if !SAFE_MINIMAL
+  console.println("\n\n");
+  console.println("███████╗███████╗██████╗ ██████╗ ██████╗ ██████╗");
+  console.println("██╔════╝██╔════╝██╔══██╗╚════██╗╚════██╗╚════██╗");
+  console.println("███████╗███████╗██████╔╝ █████╔╝ █████╔╝ █████╔╝");
+  console.println("╚════██║╚════██║██╔═══╝ ██╔═══╝  ╚═══██╗██╔═══╝");
+  console.println("███████║███████║██║     ███████╗██████╔╝███████╗");
+  console.println("╚══════╝╚══════╝╚═╝     ╚══════╝╚═════╝ ╚══════╝");
+#endif
+  console.printf("\n          %s SAFE MODE FLASHER\n", Board::CHIP);
+  console.println("          v" FW_VERSION " | MIT License | 2024");
   
   // Start safety procedures
-  logMessage(1, "\n Starting safety procedures...");
+  logEvent<1>(EV_SAFETY_BEGIN);
   
-  // Step 1: Secure all GPIO pins
+  // Step 1: Secure all GPIO pins (bulk profile: already done pre-setup, report only)
   secureAllPins();
   
   // Step 2: Disable peripherals
   disablePeripherals();
   
-  // Step 3: Show status
+  // Step 3: Critical sequence done, let the log drain catch up
+  startLogDrain();
+  waitLogDrained(2000);
+  
+  // Step 4: Show status
   showStatus();
   
-  // Step 4: Enable heartbeat
-  logMessage(1, "Safety mode active. Monitoring...");
+  // Step 5: Enable heartbeat, status tick and command events
+  startHeartbeatLed();
+  startEventSources();
+  recordWarmState();
+  
+  // Step 6: Radio for Wi-Fi OTA, if built in (after the pins verify)
+  startWifiOta();
+#if IDLE_MODE_AUTO
+  toggleIdleMode();
+#endif
+  logEvent<1>(EV_SAFETY_ACTIVE);
 }
 
 // ==================== MAIN LOOP ====================
-void loop() {
-  static unsigned long lastHeartbeat = 0;
-  static unsigned long lastStatus = 0;
-  
-  unsigned long now = millis();
+void statusTick() {
+  outBegin();
+  outln("\n[STATUS CHECK] System still in safe mode.");
+  outf("  Uptime: %lu seconds\n", millis() / 1000);
+  outs("  ");
+  printVerify(verifyPins());
+  if (driveActivity().active) {
+    outs("  ");
+    printDriveActivity();
+  }
+  outln("  Ready for firmware upload.");
+  outEnd();
+}
+
+void handleCommand(char cmd) {
+  if (policyEditing) {
+    policyEditByte(cmd);
+    return;
+  }
+  if (commandLineActive) {
+    commandLineByte(cmd);
+    return;
+  }
   
-  // Heartbeat LED (if GPIO2 is available and not critical)
-  if (now - lastHeartbeat > 1000) {
-    lastHeartbeat = now;
-    
-    // Simple software blink (no hardware PWM)
-    static bool ledState = false;
-    if (!isCriticalPin(2) && !isUsbUartPin(2)) {
-      digitalWrite(2, ledState ? HIGH : LOW);
-      ledState = !ledState;
-    }
+  switch(cmd) {
+    case 's':
+    case 'S':
+      showStatus();
+      break;
+    case 'v':
+    case 'V':
+      verboseMode = !verboseMode;
+      console.printf("\nVerbose mode: %s\n", verboseMode ? "ON" : "OFF");
+#if LOG_LEVEL < LOG_VERBOSE
+      console.println("(verbose records compiled out, LOG_LEVEL < 2)");
+#endif
+      break;
+    case 'r':
+    case 'R':
+      console.println("\nRestarting...");
+      restartBoard();
+      break;
+    case ':':
+      commandLineActive = true;
+      commandLineLen = 0;
+      commandLineOverflow = false;
+      break;
+    case 't':
+    case 'T':
+      printTimings();
+      break;
+    case 'j':
+    case 'J':
+      printStatusFrame();
+      break;
+    case 'i':
+    case 'I':
+      toggleIdleMode();
+      break;
+    case 'p':
+    case 'P':
+      parkBoard();
+      break;
+    case 'c':
+    case 'C':
+      printVerify(verifyPins());
+      break;
+    case 'm':
+    case 'M':
+      toggleDriveMonitor();
+      break;
+    case 'a':
+    case 'A':
+      printDriveActivity();
+      break;
+    case 'o':
+    case 'O':
+      printPolicy();
+      break;
+    case 'e':
+    case 'E':
+      startPolicyEdit();
+      break;
+    case 'u':
+    case 'U':
+      receiveFirmware();
+      break;
+    case 'g':
+    case 'G':
+      handoffNow();
+      break;
+    case 'k':
+    case 'K':
+      stayInSafeMode();
+      break;
+    case 'l':
+    case 'L':
+      printLatency();
+      break;
+    case 'z':
+    case 'Z':
+      resetLatency();
+      console.println("\nLatency counters cleared");
+      break;
+    case '?':
+    case 'h':
+    case 'H':
+      console.println("\n COMMANDS:");
+      console.println("  s - Show status");
+      console.println("  t - Phase timings, heap and stack");
+      console.println("  l - Loop latency histograms, longest stall, task stacks");
+      console.println("  z - Clear the latency counters");
+      console.println("  j - One-line JSON status frame");
+      console.println("  c - Verify pin state against policy");
+      console.println("  m - Toggle external drive monitor");
+      console.println("  a - Show drive activity per pin");
+      console.println("  o - Show pin policy table");
+      console.println("  e - Edit pin policy (stored in NVS)");
+      console.println("  u - Receive firmware into the OTA slot, then boot it");
+      console.println("  g - Hand off to the application (resident build)");
+      console.println("  k - Boot safe mode on every reset until 'g' (resident build)");
+      console.println("  i - Toggle idle mode (pin hold + light sleep)");
+      console.println("  p - Park: deep sleep with pins held");
+      console.println("  v - Toggle verbose mode");
+      console.println("  r - Restart (software reset, pins stay secured)");
+      console.println("  :<line> - Line command (:pin, :masks, :set, :save, :restart)");
+      console.println("  h - This help");
+      break;
   }
+}
+
+void safeModeLoop() {
+  // Block until a serial byte or timer tick arrives; no polling
+  uint32_t events = 0;
+  xTaskNotifyWait(0, UINT32_MAX, &events, portMAX_DELAY);
+  LatencyMark wake = latencyWoke();
   
-  // Periodic status update
-  if (now - lastStatus > 30000) {  // Every 30 seconds
-    lastStatus = now;
-    Serial.println("\n[STATUS CHECK] System still in safe mode.");
-    Serial.printf("  Uptime: %lu seconds\n", now / 1000);
-    Serial.println("  Ready for firmware upload.");
-  }
-  
-  // Check for serial commands
-  if (Serial.available()) {
-    char cmd = Serial.read();
-    switch(cmd) {
-      case 's':
-      case 'S':
-        showStatus();
-        break;
-      case 'v':
-      case 'V':
-        verboseMode = !verboseMode;
-        Serial.printf("\nVerbose mode: %s\n", verboseMode ? "ON" : "OFF");
-        break;
-      case 'r':
-      case 'R':
-        Serial.println("\n  Simulating reset...");
-        Serial.println("(In real hardware, press RESET button)");
-        break;
-      case '?':
-      case 'h':
-      case 'H':
-        Serial.println("\n COMMANDS:");
-        Serial.println("  s - Show status");
-        Serial.println("  v - Toggle verbose mode");
-        Serial.println("  r - Reset reminder");
-        Serial.println("  h - This help");
-        break;
+  if (events & EVT_SERIAL_RX) {
+    rearmAutoPark();
+    while (Serial.available()) {
+      char cmd = Serial.read();
+      LatencyMark start = latencyMark();
+      handleCommand(cmd);
+      latencySpan(start, LAT_COMMAND, cmd);
     }
   }
-  
-  // Minimal delay
-  delay(100);
+  if (events & EVT_STATUS_TICK) {
+    LatencyMark start = latencyMark();
+    statusTick();
+    latencySpan(start, LAT_STATUS_TICK);
+  }
+  if (events & EVT_AUTO_PARK) parkBoard();
+  if (events & EVT_OTA_DONE) finishFirmware(otaStats().result);
+  latencyIterationEnd(wake);
+}
+
+// The on-target suite (test/) provides its own setup()/loop()
+#ifndef PIO_UNIT_TESTING
+void setup() {
+  safeModeSetup();
+}
+
+void loop() {
+  safeModeLoop();
 }
+#endif
 
 // ==================== END OF FILE ====================
\ No newline at end of file
@@ -0,0 +1,54 @@
+/**
+ * Hardware heartbeat
+ * See include/safe_heartbeat.h
+ */
+
+#include "safe_heartbeat.h"
+#include "driver/ledc.h"
+#include "esp_sleep.h"
+
+#define HEARTBEAT_MODE    LEDC_LOW_SPEED_MODE
+#define HEARTBEAT_TIMER   LEDC_TIMER_0
+#define HEARTBEAT_CHANNEL LEDC_CHANNEL_0
+
+static bool running = false;
+
+esp_err_t startHeartbeat() {
+  if (HEARTBEAT_PIN < 0) return ESP_ERR_NOT_SUPPORTED;
+  if (running) return ESP_OK;
+  
+  ledc_timer_config_t timer = {};
+  timer.speed_mode = HEARTBEAT_MODE;
+  timer.duty_resolution = (ledc_timer_bit_t)HEARTBEAT_RESOLUTION;
+  timer.timer_num = HEARTBEAT_TIMER;
+  timer.freq_hz = HEARTBEAT_HZ;
+  timer.clk_cfg = LEDC_USE_RC_FAST_CLK;   // The only LEDC clock that runs in light sleep
+  esp_err_t err = ledc_timer_config(&timer);
+  if (err != ESP_OK) return err;
+  
+  ledc_channel_config_t channel = {};
+  channel.gpio_num = HEARTBEAT_PIN;
+  channel.speed_mode = HEARTBEAT_MODE;
+  channel.channel = HEARTBEAT_CHANNEL;
+  channel.timer_sel = HEARTBEAT_TIMER;
+  channel.duty = ((1UL << HEARTBEAT_RESOLUTION) * HEARTBEAT_PERMILLE) / 1000;
+  channel.hpoint = 0;
+  err = ledc_channel_config(&channel);
+  if (err != ESP_OK) return err;
+  
+  // Light sleep powers RC_FAST down unless something asks for it
+  esp_sleep_pd_config(ESP_PD_DOMAIN_RC_FAST, ESP_PD_OPTION_ON);
+  running = true;
+  return ESP_OK;
+}
+
+void stopHeartbeat() {
+  if (!running) return;
+  ledc_stop(HEARTBEAT_MODE, HEARTBEAT_CHANNEL, 0);
+  esp_sleep_pd_config(ESP_PD_DOMAIN_RC_FAST, ESP_PD_OPTION_AUTO);
+  running = false;
+}
+
+bool heartbeatRunning() {
+  return running;
+}
\ No newline at end of file
@@ -0,0 +1,79 @@
+/**
+ * Loop latency instrumentation
+ * See include/safe_latency.h
+ */
+
+#include "safe_latency.h"
+#include <atomic>
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+#include "esp_timer.h"
+
+static LatencyStats stats = {};
+static std::atomic<uint32_t> postedUs{0};   // First unserved post, 0 when none
+
+static uint32_t nowUs() {
+  uint32_t us = (uint32_t)esp_timer_get_time();
+  return us ? us : 1;                   // 0 marks "nothing pending"
+}
+
+LatencyMark latencyMark() {
+  return {esp_cpu_get_cycle_count(), nowUs()};
+}
+
+// Short spans from the cycle counter at the current CPU clock (esp_pm may
+// change it while idle); anything near a counter wrap from esp_timer
+static uint32_t elapsedUs(const LatencyMark& start) {
+  uint32_t us = nowUs() - start.us;
+  uint32_t perUs = esp_rom_get_cpu_ticks_per_us();
+  if (us > LAT_CYCLES_MAX_US || !perUs) return us;
+  return (esp_cpu_get_cycle_count() - start.cycles) / perUs;
+}
+
+int latencyBucketOf(uint32_t us) {
+  int bucket = us ? 32 - __builtin_clz(us) : 0;
+  return bucket < LAT_BUCKETS ? bucket : LAT_BUCKETS - 1;
+}
+
+static void record(LatencyHistogram& h, uint32_t us) {
+  h.buckets[latencyBucketOf(us)]++;
+  h.count++;
+  h.totalUs += us;
+  if (us > h.maxUs) h.maxUs = us;
+}
+
+void latencyPosted() {
+  uint32_t expected = 0;
+  postedUs.compare_exchange_strong(expected, nowUs(), std::memory_order_relaxed);
+}
+
+LatencyMark latencyWoke() {
+  LatencyMark mark = latencyMark();
+  uint32_t posted = postedUs.exchange(0, std::memory_order_relaxed);
+  if (posted) record(stats.wake, mark.us - posted);
+  stats.lastWakeCycles = mark.cycles;
+  return mark;
+}
+
+void latencySpan(const LatencyMark& start, LatencyCause cause, char tag) {
+  uint32_t us = elapsedUs(start);
+  if (cause == LAT_COMMAND) record(stats.command, us);
+  if (us > stats.stallUs) {
+    stats.stallUs = us;
+    stats.stallCause = cause;
+    stats.stallTag = tag;
+    stats.stallAtMs = millis();
+  }
+}
+
+void latencyIterationEnd(const LatencyMark& wake) {
+  record(stats.iteration, elapsedUs(wake));
+}
+
+const LatencyStats& latencyStats() {
+  return stats;
+}
+
+void resetLatency() {
+  stats = {};
+}
\ No newline at end of file
@@ -0,0 +1,157 @@
+/**
+ * Asynchronous event logger
+ * See include/safe_log.h
+ */
+
+#include "safe_log.h"
+#include <atomic>
+#include "esp_timer.h"
+#include "safe_tx.h"
+
+#define LOG_DRAIN_STACK     3072
+#define LOG_DRAIN_PRIORITY  (tskIDLE_PRIORITY + 1)
+
+struct LogFormat {
+  const char* format;                 // nullptr when stripped by LOG_LEVEL
+  bool withPin;                       // format takes (pin, arg) instead of (arg)
+};
+
+static const LogFormat LOG_FORMATS[EV_COUNT] = {
+  /* EV_SAFETY_BEGIN      */ {LOG_TEXT(1, "\n Starting safety procedures..."), false},
+  /* EV_SAFETY_ACTIVE     */ {LOG_TEXT(1, "Safety mode active. Monitoring..."), false},
+  /* EV_SECURE_BEGIN      */ {LOG_TEXT(1, "\n Securing GPIO pins..."), false},
+  /* EV_SECURE_EARLY      */ {LOG_TEXT(2, "  Already secured by early-boot hook"), false},
+  /* EV_SECURE_DONE       */ {LOG_TEXT(1, " All pins secured in %lu us"), false},
+  /* EV_SAFE_AT           */ {LOG_TEXT(1, " Safe at T+%lu us"), false},
+  /* EV_PIN_SKIP_INVALID  */ {LOG_TEXT(2, "  Skip GPIO%02d: Invalid GPIO"), true},
+  /* EV_PIN_SKIP_CRITICAL */ {LOG_TEXT(2, "  Skip GPIO%02d: Critical system pin"), true},
+  /* EV_PIN_USB_UART      */ {LOG_TEXT(2, "  GPIO%02d: INPUT (USB/UART)"), true},
+  /* EV_PIN_USB_UART_KEPT */ {LOG_TEXT(2, "  GPIO%02d: untouched (USB/UART)"), true},
+  /* EV_PIN_PULLUP        */ {LOG_TEXT(2, "  GPIO%02d: INPUT_PULLUP"), true},
+  /* EV_PIN_PULLDOWN      */ {LOG_TEXT(2, "  GPIO%02d: INPUT_PULLDOWN"), true},
+  /* EV_PIN_HOLD_LOW      */ {LOG_TEXT(2, "  GPIO%02d: OUTPUT LOW (held)"), true},
+  /* EV_PIN_SKIP_POLICY   */ {LOG_TEXT(2, "  Skip GPIO%02d: Policy says skip"), true},
+  /* EV_PIN_HIGHZ         */ {LOG_TEXT(2, "  GPIO%02d: INPUT (High-Z)"), true},
+  /* EV_PIN_HEARTBEAT     */ {LOG_TEXT(2, "  Skip GPIO%02d: Heartbeat LED"), true},
+  /* EV_POLICY_LOADED     */ {LOG_TEXT(1, " Pin policy loaded from NVS in %lu us"), false},
+  /* EV_POLICY_DEFAULTS   */ {LOG_TEXT(1, " No stored pin policy, board defaults (%lu us)"), false},
+  /* EV_PERIPH_BEGIN      */ {LOG_TEXT(1, "\n🔌 Disabling peripherals..."), false},
+  /* EV_PERIPH_RUNNING    */ {LOG_TEXT(2, "  Running units: mask 0x%lx"), false},
+  /* EV_PERIPH_GATED      */ {LOG_TEXT(2, "  Reset + clock-gated: mask 0x%lx"), false},
+  /* EV_PERIPH_DONE       */ {LOG_TEXT(1, " All peripherals disabled in %lu us"), false},
+  /* EV_IDLE_SLEEP        */ {LOG_TEXT(1, " Idle: pins held, automatic light sleep on"), false},
+  /* EV_IDLE_AWAKE        */ {LOG_TEXT(1, " Idle: pins held, light sleep unavailable (esp_pm 0x%lx)"), false},
+  /* EV_PARK_ENTER        */ {LOG_TEXT(1, "\n Parking: deep sleep with pins held, wake on GPIO%02d"), true},
+  /* EV_PARK_RESUME       */ {LOG_TEXT(1, "\n Resumed from park (wake cause %lu), pins still held"), false},
+  /* EV_PARK_REFUSED      */ {LOG_TEXT(1, " Park refused: GPIO%02d wake source failed (0x%lx), staying awake"), true},
+  /* EV_WARM_RESET        */ {LOG_TEXT(1, "\n Warm reset (reason %lu): stored policy re-applied, 's' for status"), false},
+  /* EV_HOST_WAIT         */ {LOG_TEXT(2, " Host link: waited %lu ms"), false},
+  /* EV_OTA_DONE          */ {LOG_TEXT(1, "\n Firmware received (%lu bytes), restarting into it"), false},
+  /* EV_OTA_FAIL          */ {LOG_TEXT(1, "\n Firmware receive failed (0x%lx), boot partition unchanged"), false},
+  /* EV_NET_OTA_START     */ {LOG_TEXT(1, " Wi-Fi OTA: radio on, listening on TCP port %lu"), false},
+  /* EV_NET_OTA_REFUSED   */ {LOG_TEXT(1, " Wi-Fi OTA: pins failed verification, radio left off"), false},
+  /* EV_RESIDENT_STAY     */ {LOG_TEXT(1, " Resident: staying in safe mode (reason %lu)"), false},
+  /* EV_RESIDENT_HANDOFF_FAIL */ {LOG_TEXT(1, " Resident: handoff to the application failed (0x%lx)"), false},
+  /* EV_HEARTBEAT_ON      */ {LOG_TEXT(2, " Heartbeat: GPIO%02d blinking at %lu Hz (LEDC)"), true},
+  /* EV_HEARTBEAT_FAIL    */ {LOG_TEXT(1, " Heartbeat: LEDC on GPIO%02d failed (0x%lx)"), true},
+};
+
+static LogRecord logRing[LOG_RING_SIZE];
+static std::atomic<uint32_t> logHead{0};   // Next slot to write (producer)
+static std::atomic<uint32_t> logTail{0};   // Next slot to read (consumer)
+static std::atomic<uint32_t> logDropped{0};
+static TaskHandle_t drainTask = nullptr;
+
+// The drain task sleeps until there is something to print: no periodic tick.
+// Before it exists (early boot) records just queue; it drains them on start.
+static inline void wakeDrain() {
+  TaskHandle_t task = drainTask;
+  if (!task) return;
+  if (xPortInIsrContext()) {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(task, &woken);
+    portYIELD_FROM_ISR(woken);
+  } else {
+    xTaskNotifyGive(task);
+  }
+}
+
+void logPush(uint8_t level, LogEvent event, int pin, uint32_t arg) {
+  uint32_t head = logHead.load(std::memory_order_relaxed);
+  if (head - logTail.load(std::memory_order_acquire) >= LOG_RING_SIZE) {
+    logDropped.fetch_add(1, std::memory_order_relaxed);
+    wakeDrain();                          // So the drop notice goes out
+    return;
+  }
+  
+  LogRecord& rec = logRing[head & (LOG_RING_SIZE - 1)];
+  rec.timestampUs = (uint32_t)esp_timer_get_time();
+  rec.arg = arg;
+  rec.level = level;
+  rec.event = event;
+  rec.pin = (int8_t)pin;
+  logHead.store(head + 1, std::memory_order_release);
+  wakeDrain();
+}
+
+static void printRecord(const LogRecord& rec) {
+  if (rec.event >= EV_COUNT) return;
+  
+  const LogFormat& fmt = LOG_FORMATS[rec.event];
+  if (!fmt.format) return;
+  
+  char buffer[96];
+  int len;
+  if (fmt.withPin) {
+    len = snprintf(buffer, sizeof(buffer) - 2, fmt.format, rec.pin, (unsigned long)rec.arg);
+  } else {
+    len = snprintf(buffer, sizeof(buffer) - 2, fmt.format, (unsigned long)rec.arg);
+  }
+  if (len < 0) return;
+  if (len > (int)sizeof(buffer) - 3) len = sizeof(buffer) - 3;   // Truncated
+  memcpy(buffer + len, "\r\n", 2);
+  txWrite((const uint8_t*)buffer, len + 2);
+}
+
+static void drainLog() {
+  uint32_t tail = logTail.load(std::memory_order_relaxed);
+  while (tail != logHead.load(std::memory_order_acquire)) {
+    printRecord(logRing[tail & (LOG_RING_SIZE - 1)]);
+    logTail.store(++tail, std::memory_order_release);
+  }
+  
+  static uint32_t reportedDrops = 0;
+  uint32_t drops = logDropped.load(std::memory_order_relaxed);
+  if (drops != reportedDrops) {
+    console.printf("  [log] %lu records dropped\n", (unsigned long)(drops - reportedDrops));
+    reportedDrops = drops;
+  }
+}
+
+static void logDrainTask(void*) {
+  for (;;) {
+    drainLog();
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);   // A push after drainLog() leaves one pending
+  }
+}
+
+void startLogDrain() {
+  if (drainTask) return;
+  xTaskCreatePinnedToCore(logDrainTask, "logDrain", LOG_DRAIN_STACK, nullptr, LOG_DRAIN_PRIORITY,
+                          &drainTask, WORKER_CORE);
+}
+
+// Block the caller until the drain task has printed everything queued so far,
+// so direct Serial output (status, command replies) never overtakes the log.
+void waitLogDrained(uint32_t timeoutMs) {
+  if (!drainTask) return;
+  uint32_t start = millis();
+  while (logTail.load(std::memory_order_acquire) != logHead.load(std::memory_order_acquire) &&
+         millis() - start < timeoutMs) {
+    vTaskDelay(1);
+  }
+}
+
+uint32_t logDroppedCount() {
+  return logDropped.load(std::memory_order_relaxed);
+}
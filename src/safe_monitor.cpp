@@ -0,0 +1,109 @@
+/**
+ * External drive detector
+ * See include/safe_monitor.h
+ */
+
+#include "safe_monitor.h"
+#include "driver/gpio.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
+#include "soc/gpio_reg.h"
+#include "soc/soc_caps.h"
+
+static volatile uint32_t toggleCounts[64];
+static volatile uint32_t windowEdges[64];
+static volatile int64_t windowStart[64];
+static uint64_t stormMask = 0;             // Two words on these cores: only under stormLock
+static portMUX_TYPE stormLock = portMUX_INITIALIZER_UNLOCKED;
+static uint64_t watchedMask = 0;
+static esp_pm_lock_handle_t noSleepLock = nullptr;
+
+static void IRAM_ATTR onPinEdge(void* arg) {
+  int pin = (int)(intptr_t)arg;
+  toggleCounts[pin]++;
+  
+  int64_t now = esp_timer_get_time();
+  if (now - windowStart[pin] > MONITOR_WINDOW_US) {
+    windowStart[pin] = now;
+    windowEdges[pin] = 0;
+  }
+  
+  // A stuck oscillating line must not starve the CPU: mask it in place
+  if (++windowEdges[pin] > MONITOR_STORM_EDGES) {
+    REG_CLR_BIT(GPIO_PIN0_REG + pin * 4, GPIO_PIN0_INT_ENA_M);
+    portENTER_CRITICAL_ISR(&stormLock);
+    stormMask |= 1ULL << pin;
+    portEXIT_CRITICAL_ISR(&stormLock);
+  }
+}
+
+static uint64_t readLevels() {
+#if SOC_GPIO_PIN_COUNT > 32
+  return (uint64_t)REG_READ(GPIO_IN_REG) | ((uint64_t)REG_READ(GPIO_IN1_REG) << 32);
+#else
+  return REG_READ(GPIO_IN_REG);
+#endif
+}
+
+bool startDriveMonitor(uint64_t pinMask) {
+  if (watchedMask) return true;
+  
+  esp_err_t err = gpio_install_isr_service(0);
+  if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) return false;
+  
+  // Edges are missed in light sleep, so keep the chip awake while watching
+  if (!noSleepLock) esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "driveMon", &noSleepLock);
+  if (noSleepLock) esp_pm_lock_acquire(noSleepLock);
+  
+  memset((void*)toggleCounts, 0, sizeof(toggleCounts));
+  memset((void*)windowEdges, 0, sizeof(windowEdges));
+  portENTER_CRITICAL(&stormLock);
+  stormMask = 0;
+  portEXIT_CRITICAL(&stormLock);
+  
+  for (uint64_t m = pinMask; m; m &= m - 1) {
+    gpio_num_t pin = (gpio_num_t)__builtin_ctzll(m);
+    windowStart[pin] = esp_timer_get_time();
+    gpio_set_intr_type(pin, GPIO_INTR_ANYEDGE);
+    gpio_isr_handler_add(pin, onPinEdge, (void*)(intptr_t)pin);
+    gpio_intr_enable(pin);
+  }
+  watchedMask = pinMask;
+  return true;
+}
+
+void stopDriveMonitor() {
+  if (!watchedMask) return;
+  
+  for (uint64_t m = watchedMask; m; m &= m - 1) {
+    gpio_num_t pin = (gpio_num_t)__builtin_ctzll(m);
+    gpio_intr_disable(pin);
+    gpio_isr_handler_remove(pin);
+    gpio_set_intr_type(pin, GPIO_INTR_DISABLE);
+  }
+  watchedMask = 0;
+  
+  if (noSleepLock) esp_pm_lock_release(noSleepLock);
+}
+
+bool driveMonitorActive() {
+  return watchedMask != 0;
+}
+
+DriveActivity driveActivity() {
+  DriveActivity a = {};
+  a.watched = watchedMask;
+  portENTER_CRITICAL(&stormLock);
+  a.storming = stormMask;
+  portEXIT_CRITICAL(&stormLock);
+  a.levels = readLevels() & watchedMask;
+  for (uint64_t m = watchedMask; m; m &= m - 1) {
+    int pin = __builtin_ctzll(m);
+    if (toggleCounts[pin]) a.active |= 1ULL << pin;
+  }
+  return a;
+}
+
+uint32_t driveToggleCount(int pin) {
+  return (pin >= 0 && pin < 64) ? toggleCounts[pin] : 0;
+}
@@ -0,0 +1,152 @@
+/**
+ * Wi-Fi OTA endpoint
+ * See include/safe_netota.h
+ */
+
+#include "safe_netota.h"
+
+#if OTA_WIFI
+
+#include <WiFi.h>
+#include "esp_pm.h"
+#include "lwip/sockets.h"
+#include "safe_ota.h"
+
+// One client at a time, over plain TCP (TCP does the flow control):
+// host: <image bytes> <wire bytes> <z|r> <image sha256, hex>\n<wire bytes>
+// dev:  OTA OK <image bytes> <ms> <KB/s> | OTA FAIL <esp_err_t>
+
+static TaskHandle_t listenerTask = nullptr;
+static void (*doneCallback)() = nullptr;
+static esp_pm_lock_handle_t noSleepLock = nullptr;
+
+static bool readHeaderLine(int client, char* line, size_t size) {
+  size_t len = 0;
+  while (len < size - 1) {
+    char c;
+    if (recv(client, &c, 1, 0) != 1) return false;
+    if (c == '\n') break;
+    if (c != '\r') line[len++] = c;
+  }
+  line[len] = '\0';
+  return len > 0;
+}
+
+static esp_err_t receiveImage(int client, uint32_t wireBytes) {
+  while (wireBytes) {
+    uint8_t* buffer = otaAcquire(OTA_TIMEOUT_MS * 4);
+    if (!buffer) break;
+    
+    size_t len = wireBytes < OTA_CHUNK ? wireBytes : OTA_CHUNK;
+    for (size_t got = 0; got < len;) {
+      int n = recv(client, buffer + got, len - got, 0);
+      if (n <= 0) {
+        otaAbort();
+        return ESP_ERR_TIMEOUT;
+      }
+      got += n;
+    }
+    otaSubmit(buffer, len);
+    wireBytes -= len;
+  }
+  
+  if (!wireBytes || otaError() != ESP_OK) return otaFinish();   // Done, or reports the writer's error
+  otaAbort();
+  return ESP_ERR_TIMEOUT;
+}
+
+static esp_err_t serveClient(int client, bool* started) {
+  char line[112];
+  char hex[65] = "";
+  unsigned long imageBytes = 0, wireBytes = 0;
+  char enc = 0;
+  uint8_t digest[32];
+  if (!readHeaderLine(client, line, sizeof(line)) ||
+      sscanf(line, "%lu %lu %c %64s", &imageBytes, &wireBytes, &enc, hex) != 4 ||
+      !wireBytes || (enc != 'z' && enc != 'r') || !parseSha256(hex, digest)) {
+    return ESP_ERR_INVALID_ARG;         // The hash is not optional over the air
+  }
+  
+  esp_err_t err = otaBegin(OTA_SRC_TCP, imageBytes, enc == 'z' ? OTA_ZLIB : OTA_RAW, digest);
+  if (err != ESP_OK) return err;
+  *started = true;
+  
+  if (noSleepLock) esp_pm_lock_acquire(noSleepLock);   // Idle mode's light sleep would stall the link
+  err = receiveImage(client, wireBytes);
+  if (noSleepLock) esp_pm_lock_release(noSleepLock);
+  return err;
+}
+
+static void netOtaTask(void*) {
+  int listener = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(OTA_TCP_PORT);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (listener < 0 || bind(listener, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listener, 1) != 0) {
+    if (listener >= 0) close(listener);
+    listenerTask = nullptr;
+    vTaskDelete(nullptr);
+    return;
+  }
+  
+  for (;;) {
+    int client = accept(listener, nullptr, nullptr);   // Blocks; no polling while nobody connects
+    if (client < 0) continue;
+    
+    timeval timeout = {OTA_TIMEOUT_MS / 1000, (OTA_TIMEOUT_MS % 1000) * 1000};
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    bool started = false;
+    esp_err_t err = serveClient(client, &started);
+    
+    char reply[48];
+    int len = (err == ESP_OK)
+      ? snprintf(reply, sizeof(reply), "OTA OK %lu %lu %lu\n", (unsigned long)otaStats().imageBytes,
+                 (unsigned long)otaStats().durationMs, (unsigned long)otaThroughputKBps())
+      : snprintf(reply, sizeof(reply), "OTA FAIL 0x%x\n", err);
+    send(client, reply, len, 0);
+    close(client);
+    if (doneCallback && started) doneCallback();
+  }
+}
+
+esp_err_t startNetOta(void (*onDone)()) {
+  if (listenerTask) return ESP_OK;
+  doneCallback = onDone;
+  if (!noSleepLock) esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "netOta", &noSleepLock);
+  
+  WiFi.mode(WIFI_STA);
+  WiFi.setAutoReconnect(true);
+  WiFi.begin(OTA_WIFI_SSID, OTA_WIFI_PASS);   // Connects in the background
+  
+  // Receive on loop()'s core; the Wi-Fi driver and the OTA writer run on the other one
+  if (xTaskCreatePinnedToCore(netOtaTask, "netOta", OTA_TCP_STACK, nullptr, OTA_TCP_PRIORITY,
+                              &listenerTask, ARDUINO_RUNNING_CORE) != pdPASS) {
+    return ESP_ERR_NO_MEM;
+  }
+  return ESP_OK;
+}
+
+bool netOtaStarted() {
+  return listenerTask != nullptr;
+}
+
+uint32_t netOtaAddress() {
+  return WiFi.status() == WL_CONNECTED ? (uint32_t)WiFi.localIP() : 0;
+}
+
+#else
+
+esp_err_t startNetOta(void (*)()) {
+  return ESP_ERR_NOT_SUPPORTED;
+}
+
+bool netOtaStarted() {
+  return false;
+}
+
+uint32_t netOtaAddress() {
+  return 0;
+}
+
+#endif
\ No newline at end of file
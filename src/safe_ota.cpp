@@ -0,0 +1,376 @@
+/**
+ * Streaming firmware receiver
+ * See include/safe_ota.h
+ */
+
+#include "safe_ota.h"
+#include "safe_log.h"
+#include <atomic>
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "mbedtls/sha256.h"
+#include "esp_heap_caps.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "rom/miniz.h"
+
+struct OtaChunk {
+  uint8_t* data;                      // nullptr marks the end of the stream
+  size_t len;
+};
+
+static uint8_t chunkPool[OTA_BUFFERS][OTA_CHUNK];
+static QueueHandle_t filledChunks = nullptr;   // Loop task -> writer
+static QueueHandle_t emptyChunks = nullptr;    // Writer -> loop task
+static SemaphoreHandle_t writerDone = nullptr;
+
+static const esp_partition_t* slot = nullptr;
+static OtaEncoding encoding = OTA_RAW;
+static uint32_t expectedBytes = 0;
+static uint32_t eraseLimit = 0;       // expectedBytes rounded up to a sector
+static uint32_t erasedBytes = 0;      // Slot bytes erased so far, from offset 0
+static volatile esp_err_t writerError = ESP_OK;
+static std::atomic<bool> busy{false};
+static OtaStats stats = {OTA_SRC_NONE, 0, 0, 0, 0, 0, ESP_ERR_INVALID_STATE};   // No transfer yet
+
+static mbedtls_sha256_context imageHash;
+static uint8_t expectedHash[32];
+static bool checkHash = false;
+
+// Inflate state lives on the heap only while a transfer runs (~43 KB)
+static tinfl_decompressor* inflator = nullptr;
+static uint8_t* window = nullptr;     // TINFL_LZ_DICT_SIZE, doubles as the output buffer
+static size_t windowPos = 0;
+static tinfl_status inflateStatus = TINFL_STATUS_NEEDS_MORE_INPUT;
+
+static esp_err_t eraseTo(uint32_t end) {
+  end = (end + OTA_SECTOR - 1) & ~(uint32_t)(OTA_SECTOR - 1);
+  if (end > eraseLimit) end = eraseLimit;
+  if (end <= erasedBytes) return ESP_OK;
+  esp_err_t err = esp_partition_erase_range(slot, erasedBytes, end - erasedBytes);
+  if (err == ESP_OK) erasedBytes = end;
+  return err;
+}
+
+// One sector per call, only while the writer would otherwise sit idle
+static bool eraseAheadStep() {
+  if (writerError != ESP_OK || erasedBytes >= eraseLimit) return false;
+  if (erasedBytes >= stats.imageBytes + OTA_ERASE_AHEAD) return false;
+  esp_err_t err = eraseTo(erasedBytes + OTA_SECTOR);
+  if (err != ESP_OK) writerError = err;
+  return true;
+}
+
+static void writeImage(const uint8_t* data, size_t len) {
+  if (stats.imageBytes + len > expectedBytes) {
+    writerError = ESP_ERR_INVALID_SIZE;
+    return;
+  }
+  esp_err_t err = eraseTo(stats.imageBytes + len);   // Only erases when the source outran erase-ahead
+  if (err == ESP_OK) err = esp_partition_write(slot, stats.imageBytes, data, len);
+  if (err != ESP_OK) {
+    writerError = err;
+    return;
+  }
+  mbedtls_sha256_update(&imageHash, data, len);
+  stats.imageBytes += len;
+}
+
+static void inflateChunk(const uint8_t* in, size_t inLeft) {
+  while (writerError == ESP_OK && inflateStatus != TINFL_STATUS_DONE) {
+    size_t inBytes = inLeft;
+    size_t outBytes = TINFL_LZ_DICT_SIZE - windowPos;
+    inflateStatus = tinfl_decompress(inflator, in, &inBytes, window, window + windowPos, &outBytes,
+                                     TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_HAS_MORE_INPUT);
+    in += inBytes;
+    inLeft -= inBytes;
+    if (outBytes) writeImage(window + windowPos, outBytes);
+    windowPos = (windowPos + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+    
+    if (inflateStatus < TINFL_STATUS_DONE) writerError = ESP_ERR_INVALID_CRC;
+    if (inflateStatus == TINFL_STATUS_NEEDS_MORE_INPUT && !inLeft) return;
+  }
+}
+
+// Runs on WORKER_CORE; after an error it keeps recycling buffers so the
+// receiver never blocks, and the error surfaces on the next otaAcquire()
+static void otaWriterTask(void*) {
+  OtaChunk chunk;
+  for (;;) {
+    if (xQueueReceive(filledChunks, &chunk, 0) != pdTRUE) {
+      if (eraseAheadStep()) continue;
+      xQueueReceive(filledChunks, &chunk, portMAX_DELAY);
+    }
+    if (!chunk.data) break;
+    
+    if (writerError == ESP_OK) {
+      if (encoding == OTA_ZLIB) {
+        inflateChunk(chunk.data, chunk.len);
+      } else {
+        writeImage(chunk.data, chunk.len);
+      }
+    }
+    xQueueSend(emptyChunks, &chunk.data, portMAX_DELAY);
+  }
+  xSemaphoreGive(writerDone);
+  vTaskDelete(nullptr);
+}
+
+static void releaseInflator() {
+  heap_caps_free(inflator);
+  heap_caps_free(window);
+  inflator = nullptr;
+  window = nullptr;
+}
+
+static esp_err_t startPipeline(uint32_t imageSize, OtaEncoding enc) {
+  slot = esp_ota_get_next_update_partition(nullptr);
+  if (!slot) return ESP_ERR_NOT_FOUND;
+  if (!imageSize || imageSize > slot->size) return ESP_ERR_INVALID_SIZE;
+  
+  if (!filledChunks) {
+    filledChunks = xQueueCreate(OTA_BUFFERS + 1, sizeof(OtaChunk));
+    emptyChunks = xQueueCreate(OTA_BUFFERS, sizeof(uint8_t*));
+    writerDone = xSemaphoreCreateBinary();
+    if (!filledChunks || !emptyChunks || !writerDone) return ESP_ERR_NO_MEM;
+  }
+  xQueueReset(filledChunks);
+  xQueueReset(emptyChunks);
+  for (int i = 0; i < OTA_BUFFERS; i++) {
+    uint8_t* buffer = chunkPool[i];
+    xQueueSend(emptyChunks, &buffer, 0);
+  }
+  
+  encoding = enc;
+  if (encoding == OTA_ZLIB) {
+    inflator = (tinfl_decompressor*)heap_caps_malloc(sizeof(tinfl_decompressor), MALLOC_CAP_8BIT);
+    window = (uint8_t*)heap_caps_malloc(TINFL_LZ_DICT_SIZE, MALLOC_CAP_8BIT);
+    if (!inflator || !window) {
+      releaseInflator();
+      return ESP_ERR_NO_MEM;
+    }
+    tinfl_init(inflator);
+    windowPos = 0;
+    inflateStatus = TINFL_STATUS_NEEDS_MORE_INPUT;
+  }
+  
+  // Nothing is erased up front; the writer erases just ahead of itself
+  expectedBytes = imageSize;
+  eraseLimit = (imageSize + OTA_SECTOR - 1) & ~(uint32_t)(OTA_SECTOR - 1);
+  erasedBytes = 0;
+  writerError = ESP_OK;
+  mbedtls_sha256_init(&imageHash);
+  mbedtls_sha256_starts(&imageHash, 0);
+  
+  if (xTaskCreatePinnedToCore(otaWriterTask, "otaWriter", OTA_WRITER_STACK, nullptr, OTA_WRITER_PRIORITY,
+                              nullptr, WORKER_CORE) != pdPASS) {
+    mbedtls_sha256_free(&imageHash);
+    releaseInflator();
+    return ESP_ERR_NO_MEM;
+  }
+  return ESP_OK;
+}
+
+esp_err_t otaBegin(OtaSource source, uint32_t imageSize, OtaEncoding enc, const uint8_t* sha256) {
+  bool idle = false;
+  if (!busy.compare_exchange_strong(idle, true)) return ESP_ERR_INVALID_STATE;
+  
+  stats.source = source;
+  stats.wireBytes = 0;
+  stats.imageBytes = 0;
+  stats.startMs = millis();
+  stats.durationMs = 0;
+  stats.baud = 0;
+  stats.result = ESP_ERR_INVALID_STATE;
+  checkHash = sha256 != nullptr;
+  if (checkHash) memcpy(expectedHash, sha256, sizeof(expectedHash));
+  
+  esp_err_t err = startPipeline(imageSize, enc);
+  if (err != ESP_OK) {
+    stats.result = err;
+    busy = false;
+  }
+  return err;
+}
+
+uint8_t* otaAcquire(uint32_t timeoutMs) {
+  uint8_t* buffer = nullptr;
+  if (xQueueReceive(emptyChunks, &buffer, pdMS_TO_TICKS(timeoutMs)) != pdTRUE) return nullptr;
+  if (writerError != ESP_OK) {
+    xQueueSend(emptyChunks, &buffer, 0);
+    return nullptr;
+  }
+  return buffer;
+}
+
+void otaSubmit(uint8_t* buffer, size_t len) {
+  OtaChunk chunk = {buffer, len};
+  stats.wireBytes += len;
+  xQueueSend(filledChunks, &chunk, portMAX_DELAY);
+}
+
+static void drainWriter() {
+  OtaChunk end = {nullptr, 0};
+  xQueueSend(filledChunks, &end, portMAX_DELAY);
+  xSemaphoreTake(writerDone, portMAX_DELAY);
+}
+
+static void closeTransfer(esp_err_t result) {
+  releaseInflator();
+  mbedtls_sha256_free(&imageHash);
+  stats.durationMs = millis() - stats.startMs;
+  stats.result = result;
+  busy = false;
+}
+
+esp_err_t otaFinish() {
+  drainWriter();
+  
+  esp_err_t err = writerError;
+  if (err == ESP_OK && encoding == OTA_ZLIB && inflateStatus != TINFL_STATUS_DONE) err = ESP_ERR_INVALID_SIZE;
+  if (err == ESP_OK && stats.imageBytes != expectedBytes) err = ESP_ERR_INVALID_SIZE;
+  
+  uint8_t digest[32];
+  mbedtls_sha256_finish(&imageHash, digest);
+  if (err == ESP_OK && checkHash && memcmp(digest, expectedHash, sizeof(digest))) err = ESP_ERR_INVALID_CRC;
+  
+  // Re-reads the slot: image header, segment checksums and the appended SHA-256
+  if (err == ESP_OK) err = esp_ota_set_boot_partition(slot);
+  closeTransfer(err);
+  return err;
+}
+
+void otaAbort() {
+  drainWriter();
+  closeTransfer(ESP_ERR_INVALID_STATE);
+}
+
+const OtaStats& otaStats() {
+  return stats;
+}
+
+bool otaBusy() {
+  return busy;
+}
+
+esp_err_t otaError() {
+  return writerError;
+}
+
+uint32_t otaThroughputKBps() {
+  uint32_t ms = busy ? millis() - stats.startMs : stats.durationMs;
+  return ms ? (uint32_t)((uint64_t)stats.wireBytes * 1000 / 1024 / ms) : 0;
+}
+
+bool parseSha256(const char* hex, uint8_t* digest) {
+  for (int i = 0; i < 64; i++) {
+    char c = hex[i] | 0x20;
+    int nibble = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : -1;
+    if (nibble < 0) return false;
+    digest[i / 2] = (i & 1) ? (digest[i / 2] | nibble) : (nibble << 4);
+  }
+  return hex[64] == '\0' || hex[64] == ' ' || hex[64] == '\r';
+}
+
+// ==================== SERIAL FRONT END ====================
+// dev:  OTA READY <slot> <slot bytes> <max baud, 0 on USB-CDC> <chunk bytes>
+// host: <image bytes> <wire bytes> <z|r> [baud [image sha256, hex]]
+// dev:  OTA GO <baud>              (then switches a UART console to <baud>)
+// host: wire bytes in chunks; after each chunk wait for '.' (more) or 'E' (stop)
+// dev:  OTA OK <image bytes> <ms> <KB/s> | OTA FAIL <esp_err_t>   (then back to the console baud)
+
+// Empty lines (the terminal's line ending after 'u') are skipped
+static bool readHeaderLine(char* line, size_t size) {
+  uint32_t start = millis();
+  while (millis() - start < OTA_TIMEOUT_MS) {
+    size_t len = Serial.readBytesUntil('\n', line, size - 1);
+    line[len] = '\0';
+    if (len && line[len - 1] == '\r') line[--len] = '\0';
+    if (len) return true;
+  }
+  return false;
+}
+
+static esp_err_t receiveImage(uint32_t wireBytes) {
+  uint8_t* buffer = otaAcquire(OTA_TIMEOUT_MS);
+  while (buffer) {
+    size_t len = wireBytes < OTA_CHUNK ? wireBytes : OTA_CHUNK;
+    if (Serial.readBytes(buffer, len) != len) {
+      otaAbort();
+      return ESP_ERR_TIMEOUT;
+    }
+    otaSubmit(buffer, len);
+    wireBytes -= len;
+    if (!wireBytes) return otaFinish();
+    
+    // Acknowledge only once the next buffer is free: one chunk in flight
+    // while the writer works through the previous one
+    buffer = otaAcquire(OTA_TIMEOUT_MS * 4);
+    Serial.write((uint8_t)(buffer ? '.' : 'E'));
+  }
+  
+  if (writerError != ESP_OK) return otaFinish();   // Reports the writer's error
+  otaAbort();
+  return ESP_ERR_TIMEOUT;
+}
+
+esp_err_t otaReceiveSerial(uint32_t consoleBaud) {
+  const esp_partition_t* next = esp_ota_get_next_update_partition(nullptr);
+  unsigned long oldTimeout = Serial.getTimeout();
+  Serial.setTimeout(OTA_TIMEOUT_MS);
+  while (Serial.available()) Serial.read();
+  
+#if ARDUINO_USB_CDC_ON_BOOT
+  const uint32_t maxBaud = 0;           // USB runs at bus speed whatever the host sets
+#else
+  const uint32_t maxBaud = OTA_MAX_BAUD;
+#endif
+  Serial.printf("OTA READY %s %lu %lu %u\n", next ? next->label : "none",
+                next ? (unsigned long)next->size : 0UL, (unsigned long)maxBaud, (unsigned)OTA_CHUNK);
+  
+  char line[112];
+  char hex[65] = "";
+  unsigned long imageBytes = 0, wireBytes = 0, baud = 0;
+  char enc = 0;
+  uint8_t digest[32];
+  esp_err_t err = ESP_ERR_INVALID_ARG;
+  if (readHeaderLine(line, sizeof(line)) &&
+      sscanf(line, "%lu %lu %c %lu %64s", &imageBytes, &wireBytes, &enc, &baud, hex) >= 3 &&
+      wireBytes && (enc == 'z' || enc == 'r') && (!hex[0] || parseSha256(hex, digest))) {
+    err = otaBegin(OTA_SRC_SERIAL, imageBytes, enc == 'z' ? OTA_ZLIB : OTA_RAW, hex[0] ? digest : nullptr);
+  }
+  if (err != ESP_OK) {
+    Serial.printf("OTA FAIL 0x%x\n", err);
+    Serial.setTimeout(oldTimeout);
+    return err;
+  }
+  
+#if ARDUINO_USB_CDC_ON_BOOT
+  baud = 0;
+#else
+  if (!baud) baud = consoleBaud;
+  if (baud > maxBaud) baud = maxBaud;
+#endif
+  Serial.printf("OTA GO %lu\n", baud);
+#if !ARDUINO_USB_CDC_ON_BOOT
+  Serial.flush();
+  if (baud != consoleBaud) Serial.updateBaudRate(baud);
+#endif
+  stats.baud = baud;
+  
+  err = receiveImage(wireBytes);
+  if (err == ESP_OK) {
+    Serial.printf("OTA OK %lu %lu %lu\n", (unsigned long)stats.imageBytes, (unsigned long)stats.durationMs,
+                  (unsigned long)otaThroughputKBps());
+  } else {
+    Serial.printf("OTA FAIL 0x%x\n", err);
+  }
+  
+#if !ARDUINO_USB_CDC_ON_BOOT
+  Serial.flush();
+  if (baud != consoleBaud) Serial.updateBaudRate(consoleBaud);
+#endif
+  while (Serial.available()) Serial.read();   // Anything the host sent after a failure
+  Serial.setTimeout(oldTimeout);
+  return err;
+}
\ No newline at end of file
@@ -0,0 +1,151 @@
+/**
+ * Zero-heap console rendering
+ * See include/safe_out.h
+ */
+
+#include "safe_out.h"
+#include "safe_tx.h"
+#include "freertos/semphr.h"
+
+static char outBuffer[OUT_BUFFER_SIZE];
+static size_t outLen = 0;
+static int outDepth = 0;
+static uint32_t renderBytes = 0;
+static OutStats stats = {};
+
+static SemaphoreHandle_t outMutex() {
+  static StaticSemaphore_t storage;
+  static SemaphoreHandle_t mutex = xSemaphoreCreateRecursiveMutexStatic(&storage);
+  return mutex;
+}
+
+#if OUT_COUNT_ALLOCS
+// Set only inside the outermost render; other tasks' allocations are not ours
+static volatile TaskHandle_t countingTask = nullptr;
+static volatile uint32_t renderAllocs = 0;
+
+// Heap calls may come from IRAM-only contexts, hence IRAM for the wrappers
+static inline void IRAM_ATTR countAlloc(void* ptr) {
+  if (ptr && countingTask && countingTask == xTaskGetCurrentTaskHandle()) renderAllocs++;
+}
+
+extern "C" {
+void* __real_heap_caps_malloc(size_t size, uint32_t caps);
+void* __real_heap_caps_calloc(size_t n, size_t size, uint32_t caps);
+void* __real_heap_caps_realloc(void* ptr, size_t size, uint32_t caps);
+void* __real_heap_caps_malloc_default(size_t size);   // malloc(), new, newlib internals
+void* __real_heap_caps_realloc_default(void* ptr, size_t size);
+
+void* IRAM_ATTR __wrap_heap_caps_malloc(size_t size, uint32_t caps) {
+  void* ptr = __real_heap_caps_malloc(size, caps);
+  countAlloc(ptr);
+  return ptr;
+}
+
+void* IRAM_ATTR __wrap_heap_caps_calloc(size_t n, size_t size, uint32_t caps) {
+  void* ptr = __real_heap_caps_calloc(n, size, caps);
+  countAlloc(ptr);
+  return ptr;
+}
+
+void* IRAM_ATTR __wrap_heap_caps_realloc(void* ptr, size_t size, uint32_t caps) {
+  void* moved = __real_heap_caps_realloc(ptr, size, caps);
+  countAlloc(moved);
+  return moved;
+}
+
+void* IRAM_ATTR __wrap_heap_caps_malloc_default(size_t size) {
+  void* ptr = __real_heap_caps_malloc_default(size);
+  countAlloc(ptr);
+  return ptr;
+}
+
+void* IRAM_ATTR __wrap_heap_caps_realloc_default(void* ptr, size_t size) {
+  void* moved = __real_heap_caps_realloc_default(ptr, size);
+  countAlloc(moved);
+  return moved;
+}
+}
+#endif
+
+static void outFlush() {
+  if (!outLen) return;
+  txWrite((const uint8_t*)outBuffer, outLen);
+  renderBytes += outLen;
+  outLen = 0;
+}
+
+void outBegin() {
+  xSemaphoreTakeRecursive(outMutex(), portMAX_DELAY);
+  if (outDepth++ == 0) {
+    renderBytes = 0;
+#if OUT_COUNT_ALLOCS
+    renderAllocs = 0;
+    countingTask = xTaskGetCurrentTaskHandle();
+#endif
+  }
+}
+
+void outEnd() {
+  if (--outDepth == 0) {
+    outFlush();
+#if OUT_COUNT_ALLOCS
+    countingTask = nullptr;
+    int32_t allocs = (int32_t)renderAllocs;
+#else
+    int32_t allocs = -1;
+#endif
+    stats.renders++;
+    stats.lastBytes = renderBytes;
+    stats.lastAllocs = allocs;
+    if (allocs > 0) stats.allocatingRenders++;
+  }
+  xSemaphoreGiveRecursive(outMutex());
+}
+
+void outf(const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  size_t room = sizeof(outBuffer) - outLen;
+  int len = vsnprintf(outBuffer + outLen, room, format, args);
+  va_end(args);
+  if (len < 0) return;
+  
+  // Did not fit: flush what came before and format again into the empty buffer
+  if ((size_t)len >= room && outLen) {
+    outFlush();
+    room = sizeof(outBuffer);
+    va_start(args, format);
+    len = vsnprintf(outBuffer, room, format, args);
+    va_end(args);
+    if (len < 0) return;
+  }
+  outLen += ((size_t)len < room) ? (size_t)len : room - 1;   // Longer than the buffer: truncated
+}
+
+void outs(const char* text) {
+  while (*text) {
+    if (outLen == sizeof(outBuffer)) outFlush();
+    size_t n = strnlen(text, sizeof(outBuffer) - outLen);
+    memcpy(outBuffer + outLen, text, n);
+    outLen += n;
+    text += n;
+  }
+}
+
+void outln(const char* text) {
+  outs(text);
+  outs("\r\n");
+}
+
+void outRule(char c, int width) {
+  for (int i = 0; i < width; i++) {
+    if (outLen == sizeof(outBuffer)) outFlush();
+    outBuffer[outLen++] = c;
+  }
+  outs("\r\n");
+}
+
+const OutStats& outStats() {
+  return stats;
+}
\ No newline at end of file
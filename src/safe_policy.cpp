@@ -0,0 +1,197 @@
+/**
+ * Runtime pin policy
+ * See include/safe_policy.h
+ */
+
+#include "safe_policy.h"
+#include "nvs.h"
+
+// Pin N occupies bits [3N, 3N+2] of packed, least significant bit first
+struct PolicyBlob {
+  uint8_t version;
+  uint8_t packed[POLICY_PINS * POLICY_BITS / 8];
+};
+
+// Written only by the loop task (and the early hook), always as a whole under
+// masksLock; other tasks copy it under the same lock (pinPolicySnapshot())
+static PolicyMasks masks = defaultPolicyMasks();
+static portMUX_TYPE masksLock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char POLICY_LETTERS[POLICY_COUNT] = {'z', 'u', 'd', 'l', 's'};
+
+static PinPolicy policyFromMasks(const PolicyMasks& m, int pin) {
+  uint64_t bit = 1ULL << pin;
+  if (m.pullup & bit)   return POLICY_PULLUP;
+  if (m.pulldown & bit) return POLICY_PULLDOWN;
+  if (m.holdLow & bit)  return POLICY_HOLD_LOW;
+  if (m.skip & bit)     return POLICY_SKIP;
+  return POLICY_HIGHZ;
+}
+
+static void assignPin(PolicyMasks& m, int pin, PinPolicy policy) {
+  uint64_t bit = 1ULL << pin;
+  m.highz &= ~bit;
+  m.pullup &= ~bit;
+  m.pulldown &= ~bit;
+  m.holdLow &= ~bit;
+  m.skip &= ~bit;
+  
+  switch (policy) {
+    case POLICY_PULLUP:   m.pullup |= bit; break;
+    case POLICY_PULLDOWN: m.pulldown |= bit; break;
+    case POLICY_HOLD_LOW: m.holdLow |= bit; break;
+    case POLICY_SKIP:     m.skip |= bit; break;
+    default:              m.highz |= bit; break;
+  }
+}
+
+// A stored class the pad cannot take (pull on an input-only pad) falls back to high-Z
+static PinPolicy capablePolicy(int pin, PinPolicy policy) {
+  return (policyCapableMask(policy) & (1ULL << pin)) ? policy : POLICY_HIGHZ;
+}
+
+static uint8_t unpackField(const uint8_t* packed, int pin) {
+  int bitPos = pin * POLICY_BITS;
+  uint16_t pair = packed[bitPos / 8];
+  if (bitPos / 8 + 1 < (int)sizeof(PolicyBlob::packed)) pair |= packed[bitPos / 8 + 1] << 8;
+  return (pair >> (bitPos % 8)) & ((1 << POLICY_BITS) - 1);
+}
+
+static void packField(uint8_t* packed, int pin, uint8_t value) {
+  int bitPos = pin * POLICY_BITS;
+  for (int b = 0; b < POLICY_BITS; b++, bitPos++) {
+    if (value & (1 << b)) packed[bitPos / 8] |= 1 << (bitPos % 8);
+  }
+}
+
+static void publishMasks(const PolicyMasks& next) {
+  portENTER_CRITICAL(&masksLock);
+  masks = next;
+  portEXIT_CRITICAL(&masksLock);
+}
+
+const PolicyMasks& pinPolicy() {
+  return masks;
+}
+
+PolicyMasks pinPolicySnapshot() {
+  portENTER_CRITICAL(&masksLock);
+  PolicyMasks copy = masks;
+  portEXIT_CRITICAL(&masksLock);
+  return copy;
+}
+
+bool loadPinPolicy() {
+  nvs_handle_t handle;
+  if (nvs_open(POLICY_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) return false;
+  
+  PolicyBlob blob;
+  size_t len = sizeof(blob);
+  esp_err_t err = nvs_get_blob(handle, POLICY_NVS_KEY, &blob, &len);
+  nvs_close(handle);
+  if (err != ESP_OK || len != sizeof(blob) || blob.version != POLICY_VERSION) return false;
+  
+  // Locked pins keep their default whatever the blob says; unknown codes mean high-Z
+  PolicyMasks loaded = defaultPolicyMasks();
+  for (uint64_t m = POLICY_EDITABLE_MASK; m; m &= m - 1) {
+    int pin = __builtin_ctzll(m);
+    uint8_t field = unpackField(blob.packed, pin);
+    assignPin(loaded, pin, capablePolicy(pin, field < POLICY_COUNT ? (PinPolicy)field : POLICY_HIGHZ));
+  }
+  publishMasks(loaded);
+  return true;
+}
+
+esp_err_t savePinPolicy() {
+  PolicyBlob blob = {};
+  blob.version = POLICY_VERSION;
+  for (uint64_t m = POLICY_EDITABLE_MASK; m; m &= m - 1) {
+    int pin = __builtin_ctzll(m);
+    packField(blob.packed, pin, policyFromMasks(masks, pin));
+  }
+  
+  nvs_handle_t handle;
+  esp_err_t err = nvs_open(POLICY_NVS_NAMESPACE, NVS_READWRITE, &handle);
+  if (err != ESP_OK) return err;
+  
+  // Only write when the stored copy differs, so repeated saves cost no flash wear
+  PolicyBlob stored;
+  size_t len = sizeof(stored);
+  if (nvs_get_blob(handle, POLICY_NVS_KEY, &stored, &len) == ESP_OK && len == sizeof(stored) &&
+      memcmp(&stored, &blob, sizeof(blob)) == 0) {
+    nvs_close(handle);
+    return ESP_OK;
+  }
+  
+  err = nvs_set_blob(handle, POLICY_NVS_KEY, &blob, sizeof(blob));
+  if (err == ESP_OK) err = nvs_commit(handle);
+  nvs_close(handle);
+  return err;
+}
+
+esp_err_t erasePinPolicy() {
+  nvs_handle_t handle;
+  esp_err_t err = nvs_open(POLICY_NVS_NAMESPACE, NVS_READWRITE, &handle);
+  if (err != ESP_OK) return err;
+  
+  err = nvs_erase_key(handle, POLICY_NVS_KEY);
+  if (err == ESP_ERR_NVS_NOT_FOUND) err = ESP_OK;
+  if (err == ESP_OK) err = nvs_commit(handle);
+  nvs_close(handle);
+  return err;
+}
+
+void adoptPinPolicy(const PolicyMasks& saved) {
+  PolicyMasks adopted = defaultPolicyMasks();
+  for (uint64_t m = POLICY_EDITABLE_MASK; m; m &= m - 1) {
+    int pin = __builtin_ctzll(m);
+    assignPin(adopted, pin, capablePolicy(pin, policyFromMasks(saved, pin)));
+  }
+  publishMasks(adopted);
+}
+
+PinPolicy pinPolicyOf(int pin) {
+  return pinPolicyOf(masks, pin);
+}
+
+PinPolicy pinPolicyOf(const PolicyMasks& m, int pin) {
+  if (pin < 0 || pin >= POLICY_PINS) return POLICY_SKIP;
+  return policyFromMasks(m, pin);
+}
+
+bool stagePinPolicy(PolicyMasks* staged, int pin, PinPolicy policy) {
+  if (pin < 0 || pin >= POLICY_PINS || policy >= POLICY_COUNT) return false;
+  if (!(policyCapableMask(policy) & (1ULL << pin))) return false;
+  
+  assignPin(*staged, pin, policy);
+  return true;
+}
+
+void commitPinPolicy(const PolicyMasks& staged) {
+  publishMasks(staged);
+}
+
+bool setPinPolicy(int pin, PinPolicy policy) {
+  PolicyMasks next = masks;           // Built aside, published whole
+  if (!stagePinPolicy(&next, pin, policy)) return false;
+  publishMasks(next);
+  return true;
+}
+
+void resetPinPolicy() {
+  publishMasks(defaultPolicyMasks());
+}
+
+char pinPolicyLetter(PinPolicy policy) {
+  return policy < POLICY_COUNT ? POLICY_LETTERS[policy] : '?';
+}
+
+bool parsePinPolicy(char letter, PinPolicy* policy) {
+  for (int i = 0; i < POLICY_COUNT; i++) {
+    if (POLICY_LETTERS[i] == (letter | 0x20)) {
+      *policy = (PinPolicy)i;
+      return true;
+    }
+  }
+  return false;
+}
\ No newline at end of file
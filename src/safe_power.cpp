@@ -0,0 +1,121 @@
+/**
+ * Low-power idle for the secured state
+ * See include/safe_power.h
+ */
+
+#include "safe_power.h"
+#include "driver/gpio.h"
+#include "driver/rtc_io.h"
+#include "driver/uart.h"
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "esp_rom_sys.h"
+#include "soc/reset_reasons.h"
+#include "soc/soc_caps.h"
+
+static IdleState state = {};
+
+static void holdPins(uint64_t mask, bool hold) {
+  for (uint64_t m = mask; m; m &= m - 1) {
+    gpio_num_t pin = (gpio_num_t)__builtin_ctzll(m);
+    if (hold) gpio_hold_en(pin);
+    else      gpio_hold_dis(pin);
+  }
+
+#if !SOC_GPIO_SUPPORT_HOLD_SINGLE_IO_IN_DSLP
+  if (hold) gpio_deep_sleep_hold_en();
+  else      gpio_deep_sleep_hold_dis();
+#endif
+}
+
+static esp_err_t configureLightSleep(bool enable) {
+  // Keep min == max: the console UART is clocked from APB, so no DFS
+  int freq = getCpuFrequencyMhz();
+  esp_pm_config_t pm = {};
+  pm.max_freq_mhz = freq;
+  pm.min_freq_mhz = freq;
+  pm.light_sleep_enable = enable;
+  return esp_pm_configure(&pm);
+}
+
+void enterIdleMode(uint64_t heldMask) {
+  if (state.active) return;
+  
+  holdPins(heldMask, true);
+  state.heldMask = heldMask;
+  
+  // BOOT button: level wake so a held button keeps the chip awake
+  gpio_wakeup_enable((gpio_num_t)IDLE_WAKE_PIN, GPIO_INTR_LOW_LEVEL);
+  esp_sleep_enable_gpio_wakeup();
+
+#if ARDUINO_USB_CDC_ON_BOOT
+  // Light sleep drops the USB-CDC link, so stay awake and only latch the pads
+  state.pmError = ESP_ERR_NOT_SUPPORTED;
+#else
+  // The byte that wakes the chip is consumed by the wake logic
+  uart_set_wakeup_threshold(UART_NUM_0, IDLE_UART_WAKE_EDGES);
+  esp_sleep_enable_uart_wakeup(UART_NUM_0);
+  state.pmError = configureLightSleep(true);
+#endif
+
+  state.lightSleep = (state.pmError == ESP_OK);
+  state.active = true;
+}
+
+void exitIdleMode() {
+  if (!state.active) return;
+  
+  if (state.lightSleep) configureLightSleep(false);
+  esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_UART);
+  esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_GPIO);
+  gpio_wakeup_disable((gpio_num_t)IDLE_WAKE_PIN);
+  
+  holdPins(state.heldMask, false);
+  state = {};
+}
+
+const IdleState& idleState() {
+  return state;
+}
+
+esp_err_t enterParkMode(uint64_t heldMask, uint64_t isolateMask) {
+  const gpio_num_t wakePin = (gpio_num_t)PARK_WAKE_PIN;
+  uint64_t wakeBit = 1ULL << PARK_WAKE_PIN;
+  
+  // Light-sleep wake sources are not valid in deep sleep
+  exitIdleMode();
+  esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_ALL);
+  
+  // Arm the wake source before touching a pad: without one, deep sleep lasts
+  // until a power cycle, so a failure returns with the pads as they were
+#if SOC_PM_SUPPORT_EXT0_WAKEUP
+  esp_err_t err = esp_sleep_enable_ext0_wakeup(wakePin, 0);
+  if (err != ESP_OK) return err;
+  rtc_gpio_pullup_en(wakePin);
+  rtc_gpio_pulldown_dis(wakePin);
+#elif SOC_GPIO_SUPPORT_DEEPSLEEP_WAKEUP
+  esp_err_t err = esp_deep_sleep_enable_gpio_wakeup(wakeBit, ESP_GPIO_WAKEUP_GPIO_LOW);
+  if (err != ESP_OK) return err;
+  gpio_pullup_en(wakePin);              // Latched by the hold below
+  gpio_pulldown_dis(wakePin);
+#else
+  return ESP_ERR_NOT_SUPPORTED;
+#endif
+
+#if SOC_RTCIO_HOLD_SUPPORTED
+  // Isolated pads lose pulls and input buffers: only for plain high-Z pins
+  for (uint64_t m = isolateMask & ~wakeBit; m; m &= m - 1) {
+    gpio_num_t pin = (gpio_num_t)__builtin_ctzll(m);
+    if (rtc_gpio_is_valid_gpio(pin) && rtc_gpio_isolate(pin) == ESP_OK) heldMask &= ~(1ULL << pin);
+  }
+#endif
+  holdPins(heldMask | wakeBit, true);
+  
+  esp_deep_sleep_start();
+  return ESP_FAIL;
+}
+
+bool resumedFromPark() {
+  // ROM reset reason: valid before the IDF reset-reason service is up
+  return esp_rom_get_reset_reason(0) == RESET_REASON_CORE_DEEP_SLEEP;
+}
@@ -0,0 +1,55 @@
+/**
+ * Resident safe mode
+ * See include/safe_resident.h
+ */
+
+#include "safe_resident.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_system.h"
+
+static bool runningFromFactory() {
+  const esp_partition_t* running = esp_ota_get_running_partition();
+  return running && running->subtype == ESP_PARTITION_SUBTYPE_APP_FACTORY;
+}
+
+static bool validApp(const esp_partition_t* app) {
+  esp_app_desc_t desc;
+  return app && esp_ota_get_partition_description(app, &desc) == ESP_OK;
+}
+
+// The slot otadata still selects, if any (the bootloader fell back to factory);
+// otherwise ota_0, where 'u' writes from here, then ota_1
+const esp_partition_t* residentApp() {
+  const esp_partition_t* app = esp_ota_get_boot_partition();
+  if (app && app->subtype != ESP_PARTITION_SUBTYPE_APP_FACTORY && validApp(app)) return app;
+  
+  app = esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_0, nullptr);
+  if (validApp(app)) return app;
+  app = esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_1, nullptr);
+  return validApp(app) ? app : nullptr;
+}
+
+ResidentDecision residentDecision() {
+  if (!SAFE_RESIDENT || !runningFromFactory()) return RESIDENT_OFF;
+  return residentApp() ? RESIDENT_SELECTED : RESIDENT_NO_APP;
+}
+
+esp_err_t residentHandoff() {
+  const esp_partition_t* app = residentApp();
+  if (!app) return ESP_ERR_NOT_FOUND;
+  
+  // Verifies the image and writes otadata once; the bootloader boots it from then on
+  esp_err_t err = esp_ota_set_boot_partition(app);
+  if (err != ESP_OK) return err;
+  esp_restart();
+  return ESP_FAIL;
+}
+
+esp_err_t residentStay() {
+  if (!SAFE_RESIDENT) return ESP_ERR_NOT_SUPPORTED;
+  const esp_partition_t* factory =
+      esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_FACTORY, nullptr);
+  if (!factory) return ESP_ERR_NOT_FOUND;
+  return esp_ota_set_boot_partition(factory);
+}
\ No newline at end of file
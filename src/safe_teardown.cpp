@@ -0,0 +1,109 @@
+/**
+ * Selective peripheral teardown
+ * See include/safe_teardown.h
+ */
+
+#include "safe_teardown.h"
+#include "hal/clk_gate_ll.h"
+#include "soc/periph_defs.h"
+#include "soc/gpio_reg.h"
+#include "soc/gpio_sig_map.h"
+#include "soc/soc_caps.h"
+
+struct PeripheralUnit {
+  const char* name;
+  periph_module_t module;
+};
+
+static const PeripheralUnit UNITS[] = {
+  {"LEDC",   PERIPH_LEDC_MODULE},
+#if SOC_RMT_SUPPORTED
+  {"RMT",    PERIPH_RMT_MODULE},
+#endif
+  {"I2C0",   PERIPH_I2C0_MODULE},
+#if SOC_I2C_NUM > 1
+  {"I2C1",   PERIPH_I2C1_MODULE},
+#endif
+#if CONFIG_IDF_TARGET_ESP32
+  {"SPI2",   PERIPH_HSPI_MODULE},
+  {"SPI3",   PERIPH_VSPI_MODULE},
+#else
+  {"SPI2",   PERIPH_SPI2_MODULE},
+#if SOC_SPI_PERIPH_NUM > 2
+  {"SPI3",   PERIPH_SPI3_MODULE},
+#endif
+#endif
+  {"UART0",  PERIPH_UART0_MODULE},
+  {"UART1",  PERIPH_UART1_MODULE},
+#if SOC_UART_NUM > 2
+  {"UART2",  PERIPH_UART2_MODULE},
+#endif
+#if SOC_MCPWM_SUPPORTED
+#if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S3
+  {"MCPWM0", PERIPH_PWM0_MODULE},
+  {"MCPWM1", PERIPH_PWM1_MODULE},
+#else
+  {"MCPWM0", PERIPH_MCPWM0_MODULE},
+#endif
+#endif
+#if SOC_I2S_SUPPORTED
+  {"I2S0",   PERIPH_I2S0_MODULE},
+#if SOC_I2S_NUM > 1
+  {"I2S1",   PERIPH_I2S1_MODULE},
+#endif
+#endif
+};
+
+static constexpr int UNIT_COUNT = sizeof(UNITS) / sizeof(UNITS[0]);
+static_assert(UNIT_COUNT <= 32, "unit mask is 32 bits");
+
+uint32_t activePeripheralUnits() {
+  uint32_t active = 0;
+  for (int i = 0; i < UNIT_COUNT; i++) {
+    if (periph_ll_periph_enabled(UNITS[i].module)) active |= 1UL << i;
+  }
+  return active;
+}
+
+// Hold the running units in reset with their clocks gated. Driver objects are
+// left as they are; nothing in safe mode touches them afterwards.
+uint32_t teardownPeripherals(uint32_t keepUnits) {
+  uint32_t gated = activePeripheralUnits() & ~keepUnits;
+  for (uint32_t m = gated; m; m &= m - 1) {
+    periph_ll_disable_clk_set_rst(UNITS[__builtin_ctz(m)].module);
+  }
+  return gated;
+}
+
+int peripheralUnitCount() {
+  return UNIT_COUNT;
+}
+
+const char* peripheralUnitName(int unit) {
+  return (unit >= 0 && unit < UNIT_COUNT) ? UNITS[unit].name : "?";
+}
+
+uint32_t consoleUartUnit() {
+#if ARDUINO_USB_CDC_ON_BOOT
+  return 0;
+#else
+  for (int i = 0; i < UNIT_COUNT; i++) {
+    if (UNITS[i].module == PERIPH_UART0_MODULE) return 1UL << i;
+  }
+  return 0;
+#endif
+}
+
+uint32_t ledcUnit() {
+  for (int i = 0; i < UNIT_COUNT; i++) {
+    if (UNITS[i].module == PERIPH_LEDC_MODULE) return 1UL << i;
+  }
+  return 0;
+}
+
+void detachMatrixOutputs(uint64_t pinMask) {
+  for (uint64_t m = pinMask; m; m &= m - 1) {
+    uint32_t outSelReg = GPIO_FUNC0_OUT_SEL_CFG_REG + __builtin_ctzll(m) * 4;
+    if (REG_READ(outSelReg) != SIG_GPIO_OUT_IDX) REG_WRITE(outSelReg, SIG_GPIO_OUT_IDX);
+  }
+}
@@ -0,0 +1,158 @@
+/**
+ * Bounded console transmit
+ * See include/safe_tx.h
+ */
+
+#include "safe_tx.h"
+#include "safe_log.h"
+
+#define TX_MASK           (TX_RING_SIZE - 1)
+
+ConsoleTx console;
+
+static char txRing[TX_RING_SIZE];
+static uint32_t txHead = 0;             // Free-running write index
+static uint32_t txTail = 0;             // Free-running read index
+static char frameSlot[TX_FRAME_SIZE];
+static size_t frameLen = 0;             // Unsent status frame, 0 when none
+static bool held = false;
+static bool sending = false;            // Drain has bytes out of the ring but not yet written
+static TxStats stats = {};
+static portMUX_TYPE txLock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t drainTask = nullptr;
+
+// Oldest whole lines go first, so the host never sees the end of a line without its start
+static void dropOldest(uint32_t need) {
+  uint32_t target = txTail + need;
+  while (txTail != txHead && ((int32_t)(target - txTail) > 0 || txRing[(txTail - 1) & TX_MASK] != '\n')) {
+    txTail++;
+    stats.droppedBytes++;
+  }
+}
+
+size_t txWrite(const uint8_t* data, size_t len) {
+  size_t accepted = len;
+  size_t skipped = 0;
+  if (len > TX_RING_SIZE) {             // Only the newest part of an oversized write fits
+    skipped = len - TX_RING_SIZE;
+    data += skipped;
+    len = TX_RING_SIZE;
+  }
+  
+  portENTER_CRITICAL(&txLock);
+  stats.droppedBytes += skipped;
+  uint32_t used = txHead - txTail;
+  if (used + len > TX_RING_SIZE) dropOldest(used + len - TX_RING_SIZE);
+  size_t first = TX_RING_SIZE - (txHead & TX_MASK);
+  if (first > len) first = len;
+  memcpy(txRing + (txHead & TX_MASK), data, first);
+  memcpy(txRing, data + first, len - first);
+  txHead += len;
+  stats.queuedBytes += len;
+  if (txHead - txTail > stats.peakBytes) stats.peakBytes = txHead - txTail;
+  portEXIT_CRITICAL(&txLock);
+  
+  if (drainTask) xTaskNotifyGive(drainTask);
+  return accepted;
+}
+
+void txFrame(const char* frame, size_t len) {
+  if (len > TX_FRAME_SIZE - 2) len = TX_FRAME_SIZE - 2;
+  portENTER_CRITICAL(&txLock);
+  if (frameLen) stats.framesReplaced++;
+  memcpy(frameSlot, frame, len);
+  memcpy(frameSlot + len, "\r\n", 2);
+  frameLen = len + 2;
+  portEXIT_CRITICAL(&txLock);
+  
+  if (drainTask) xTaskNotifyGive(drainTask);
+}
+
+// Next piece to send: the status frame at a line boundary, else ring bytes.
+// Called with nothing pending; returns 0 when there is nothing to send.
+static size_t takeChunk(char* chunk, bool lineStart) {
+  size_t len = 0;
+  portENTER_CRITICAL(&txLock);
+  if (!held) {
+    if (lineStart && frameLen) {
+      memcpy(chunk, frameSlot, frameLen);
+      len = frameLen;
+      frameLen = 0;
+    } else {
+      uint32_t avail = txHead - txTail;
+      len = avail < TX_FRAME_SIZE ? avail : TX_FRAME_SIZE;
+      for (size_t i = 0; i < len; i++) chunk[i] = txRing[(txTail + i) & TX_MASK];
+      txTail += len;
+    }
+  }
+  sending = len > 0;
+  portEXIT_CRITICAL(&txLock);
+  return len;
+}
+
+static void txDrainTask(void*) {
+  static char chunk[TX_FRAME_SIZE];
+  size_t len = 0, off = 0;
+  bool lineStart = true;
+  uint32_t reportedDrops = 0;
+  
+  for (;;) {
+    if (off == len) {
+      off = 0;
+      len = 0;
+      uint32_t drops = stats.droppedBytes;
+      if (lineStart && drops != reportedDrops && !held) {
+        len = snprintf(chunk, sizeof(chunk), "  [tx] %lu bytes dropped\r\n", (unsigned long)(drops - reportedDrops));
+        reportedDrops = drops;
+        sending = true;
+      } else {
+        len = takeChunk(chunk, lineStart);
+      }
+      if (!len) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        continue;
+      }
+    }
+    
+    int room = held ? 0 : Serial.availableForWrite();
+    size_t n = 0;
+    if (room > 0) {
+      n = Serial.write((const uint8_t*)chunk + off, (size_t)room < len - off ? (size_t)room : len - off);
+    }
+    if (!n) {
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(TX_RETRY_MS));
+      continue;
+    }
+    off += n;
+    stats.sentBytes += n;
+    lineStart = chunk[off - 1] == '\n';
+    if (off == len) sending = false;
+  }
+}
+
+void txBegin() {
+  if (drainTask) return;
+  xTaskCreatePinnedToCore(txDrainTask, "txDrain", TX_DRAIN_STACK, nullptr, TX_DRAIN_PRIORITY,
+                          &drainTask, WORKER_CORE);
+}
+
+void txFlush(uint32_t timeoutMs) {
+  if (!drainTask) return;
+  uint32_t start = millis();
+  while (millis() - start < timeoutMs) {
+    portENTER_CRITICAL(&txLock);
+    bool empty = txHead == txTail && !frameLen && !sending;
+    portEXIT_CRITICAL(&txLock);
+    if (empty) return;
+    vTaskDelay(1);
+  }
+}
+
+void txHold(bool hold) {
+  held = hold;
+  if (drainTask) xTaskNotifyGive(drainTask);
+}
+
+const TxStats& txStats() {
+  return stats;
+}
\ No newline at end of file
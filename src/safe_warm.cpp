@@ -0,0 +1,82 @@
+/**
+ * Warm-reset fast path
+ * See include/safe_warm.h
+ */
+
+#include "safe_warm.h"
+#include "esp_app_desc.h"
+#include "esp_rom_sys.h"
+#include "soc/reset_reasons.h"
+
+struct WarmRecord {
+  uint32_t magic;
+  PolicyMasks masks;
+  uint32_t policyHash;                // Over this build's ID and the masks
+};
+
+// Survives software and watchdog resets; garbage after power-on, which the hash rejects
+RTC_NOINIT_ATTR static WarmRecord warmRecord;
+RTC_NOINIT_ATTR static WarmRecord parkRecord;   // Same layout, PARK_MAGIC
+
+// FNV-1a; the build ID keeps a record from an older image (e.g. before OTA) from matching
+static uint32_t fnv1a(uint32_t hash, const void* data, size_t len) {
+  const uint8_t* bytes = (const uint8_t*)data;
+  for (size_t i = 0; i < len; i++) hash = (hash ^ bytes[i]) * 16777619UL;
+  return hash;
+}
+
+static uint32_t policyHash(const PolicyMasks& masks) {
+  uint32_t hash = fnv1a(2166136261UL, esp_app_get_description()->app_elf_sha256, 8);
+  return fnv1a(hash, &masks, sizeof(masks));
+}
+
+// Only resets that leave RTC memory and the pads' last state trustworthy
+static bool isWarmReason(soc_reset_reason_t reason) {
+  switch (reason) {
+    case RESET_REASON_CORE_SW:
+    case RESET_REASON_CPU0_SW:
+    case RESET_REASON_CORE_MWDT0:
+    case RESET_REASON_CORE_MWDT1:
+    case RESET_REASON_CORE_RTC_WDT:
+    case RESET_REASON_CPU0_MWDT0:
+    case RESET_REASON_CPU0_RTC_WDT:
+    case RESET_REASON_SYS_RTC_WDT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+const PolicyMasks* warmResetPolicy() {
+  if (!isWarmReason(esp_rom_get_reset_reason(0))) return nullptr;
+  if (warmRecord.magic != WARM_MAGIC) return nullptr;
+  if (warmRecord.policyHash != policyHash(warmRecord.masks)) return nullptr;
+  return &warmRecord.masks;
+}
+
+void markWarmReset(const PolicyMasks& masks) {
+  warmRecord.masks = masks;
+  warmRecord.policyHash = policyHash(masks);
+  warmRecord.magic = WARM_MAGIC;
+}
+
+void clearWarmReset() {
+  warmRecord.magic = 0;
+}
+
+const PolicyMasks* parkedPolicy() {
+  if (esp_rom_get_reset_reason(0) != RESET_REASON_CORE_DEEP_SLEEP) return nullptr;
+  if (parkRecord.magic != PARK_MAGIC) return nullptr;
+  if (parkRecord.policyHash != policyHash(parkRecord.masks)) return nullptr;
+  return &parkRecord.masks;
+}
+
+void markParkedPolicy(const PolicyMasks& masks) {
+  parkRecord.masks = masks;
+  parkRecord.policyHash = policyHash(masks);
+  parkRecord.magic = PARK_MAGIC;
+}
+
+uint32_t warmResetReason() {
+  return (uint32_t)esp_rom_get_reset_reason(0);
+}
\ No newline at end of file
@@ -0,0 +1,166 @@
+/**
+ * On-target benchmark and regression suite
+ * Runs the real safe-mode sequence (safe_main.h) in place of setup() and
+ * measures it. Every measurement is one machine-readable line:
+ *
+ *   BENCH <metric> <value> <unit> <limit|-> <PASS|FAIL|INFO>
+ *
+ * followed by the Unity verdict. Limits are build flags (-DBENCH_MAX_...) so a
+ * station can tighten them per board. Run with: pio test -e <env>
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include "esp_timer.h"
+#include "safe_main.h"
+#include "safe_out.h"
+#include "safe_power.h"
+#include "safe_tx.h"
+
+// ==================== THRESHOLDS ====================
+#ifndef BENCH_MAX_SAFE_AT_US
+#define BENCH_MAX_SAFE_AT_US      150000  // App start to pins safe (early hook)
+#endif
+#ifndef BENCH_MAX_SECURE_US
+#define BENCH_MAX_SECURE_US       500     // Bulk securing, whole walk
+#endif
+#ifndef BENCH_MAX_POLICY_US
+#define BENCH_MAX_POLICY_US       20000   // NVS policy read
+#endif
+#ifndef BENCH_MAX_PERIPH_US
+#define BENCH_MAX_PERIPH_US       2000    // Late teardown sweep
+#endif
+#ifndef BENCH_MAX_STATUS_US
+#define BENCH_MAX_STATUS_US       20000   // showStatus() render into the TX ring
+#endif
+#ifndef BENCH_MAX_COMMAND_US
+#define BENCH_MAX_COMMAND_US      5000    // handleCommand() until the reply is queued
+#endif
+#ifndef BENCH_MAX_STATUS_ALLOCS
+#define BENCH_MAX_STATUS_ALLOCS   0       // Heap allocations made by one showStatus()
+#endif
+#ifndef BENCH_IDLE_WINDOW_MS
+#define BENCH_IDLE_WINDOW_MS      5000    // Idle window for an external current meter
+#endif
+#define BENCH_ROUNDS              8       // Repeats per command; the worst one counts
+#define BENCH_NO_LIMIT            -1
+
+// ==================== REPORTING ====================
+// Through the console ring, then drained, so BENCH lines and Unity's own
+// Serial output never interleave
+static bool bench(const char* metric, long value, const char* unit, long limit) {
+  bool pass = limit == BENCH_NO_LIMIT || value <= limit;
+  if (limit == BENCH_NO_LIMIT) {
+    console.printf("BENCH %s %ld %s - INFO\n", metric, value, unit);
+  } else {
+    console.printf("BENCH %s %ld %s %ld %s\n", metric, value, unit, limit, pass ? "PASS" : "FAIL");
+  }
+  txFlush(1000);
+  return pass;
+}
+
+static void benchPhase(Phase phase, const char* metric, long limit) {
+  TEST_ASSERT_TRUE_MESSAGE(bench(metric, (long)phaseTimings[phase].durationUs, "us", limit), PHASE_NAMES[phase]);
+}
+
+// ==================== TESTS ====================
+void setUp() {}
+void tearDown() {}
+
+void test_time_to_safe() {
+  TEST_ASSERT_TRUE_MESSAGE(earlySecured, "early hook did not secure the pins");
+  TEST_ASSERT_TRUE(bench("safe_at", (long)safeAtUs, "us", BENCH_MAX_SAFE_AT_US));
+}
+
+void test_phase_secure() {
+  benchPhase(PHASE_SECURE, "phase_secure", BENCH_MAX_SECURE_US);
+}
+
+void test_phase_policy() {
+  benchPhase(PHASE_POLICY, "phase_policy", BENCH_MAX_POLICY_US);
+}
+
+void test_phase_peripherals() {
+  benchPhase(PHASE_PERIPHERALS, "phase_peripherals", BENCH_MAX_PERIPH_US);
+}
+
+void test_pins_verified() {
+  TEST_ASSERT_TRUE_MESSAGE(pinsVerified(), "secured pads do not match the policy");
+}
+
+void test_status_heap() {
+  showStatus();
+  txFlush(5000);
+  bool fast = bench("phase_status", (long)phaseTimings[PHASE_STATUS].durationUs, "us", BENCH_MAX_STATUS_US);
+  bench("status_bytes", (long)outStats().lastBytes, "B", BENCH_NO_LIMIT);
+  TEST_ASSERT_TRUE_MESSAGE(outStats().lastAllocs >= 0, "built without OUT_COUNT_ALLOCS");
+  TEST_ASSERT_TRUE_MESSAGE(bench("status_allocs", (long)outStats().lastAllocs, "allocs",
+                                 BENCH_MAX_STATUS_ALLOCS), "showStatus() allocated from the heap");
+  TEST_ASSERT_TRUE_MESSAGE(fast, PHASE_NAMES[PHASE_STATUS]);
+}
+
+// Read-only commands: dispatch to reply queued (the limit), then to reply handed to the port
+void test_command_latency() {
+  static const char COMMANDS[] = "ctajo";
+  bool pass = true;
+  for (const char* c = COMMANDS; *c; c++) {
+    uint32_t worst = 0, worstDrain = 0;
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+      int64_t start = esp_timer_get_time();
+      handleCommand(*c);
+      int64_t queued = esp_timer_get_time();
+      txFlush(5000);
+      uint32_t handled = (uint32_t)(queued - start);
+      uint32_t drained = (uint32_t)(esp_timer_get_time() - start);
+      if (handled > worst) worst = handled;
+      if (drained > worstDrain) worstDrain = drained;
+    }
+    
+    char metric[24];
+    snprintf(metric, sizeof(metric), "cmd_%c", *c);
+    pass &= bench(metric, (long)worst, "us", BENCH_MAX_COMMAND_US);
+    snprintf(metric, sizeof(metric), "cmd_%c_drained", *c);
+    bench(metric, (long)worstDrain, "us", BENCH_NO_LIMIT);
+  }
+  TEST_ASSERT_TRUE(pass);
+}
+
+// Markers bracket a window in which nothing but the idle state runs, for a
+// current meter or power profiler on the supply rail to line up against
+void test_idle_current_window() {
+  console.printf("BENCH idle_window_begin %d ms\n", BENCH_IDLE_WINDOW_MS);
+  txFlush(1000);
+  Serial.flush();
+  
+  toggleIdleMode();
+  bool active = idleState().active;
+  bool lightSleep = idleState().lightSleep;
+  delay(BENCH_IDLE_WINDOW_MS);
+  toggleIdleMode();
+  txFlush(1000);
+  
+  console.printf("BENCH idle_window_end %d ms\n", BENCH_IDLE_WINDOW_MS);
+  bench("idle_light_sleep", lightSleep, "bool", BENCH_NO_LIMIT);
+  TEST_ASSERT_TRUE_MESSAGE(active, "idle mode did not latch the pins");
+  TEST_ASSERT_TRUE_MESSAGE(pinsVerified(), "pins changed across the idle window");
+}
+
+// ==================== MAIN ====================
+void setup() {
+  safeModeSetup();
+  if (idleState().active) exitIdleMode();   // IDLE_MODE_AUTO: the suite picks its own idle window
+  txFlush(5000);
+  
+  UNITY_BEGIN();
+  RUN_TEST(test_time_to_safe);
+  RUN_TEST(test_phase_secure);
+  RUN_TEST(test_phase_policy);
+  RUN_TEST(test_phase_peripherals);
+  RUN_TEST(test_pins_verified);
+  RUN_TEST(test_status_heap);
+  RUN_TEST(test_command_latency);
+  RUN_TEST(test_idle_current_window);
+  UNITY_END();
+}
+
+void loop() {}
\ No newline at end of file
@@ -0,0 +1,223 @@
+/**
+ * fleetflash - parallel safe-mode fleet flasher
+ * Opens every port given on the command line, confirms each board reports a
+ * verified safe state in its JSON status frame, then pushes the application
+ * image to all of them at once through the streaming receiver. One epoll loop
+ * drives every port, so rack time follows the slowest board, not the count.
+ *
+ *   fleetflash [--baud N] [--raw] app.bin /dev/ttyUSB0 /dev/ttyUSB1 ...
+ *   fleetflash [--baud N] --check /dev/ttyUSB0 /dev/ttyUSB1 ...
+ */
+
+#include "serial_port.h"
+#include "session.h"
+#include "sha256.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#if FLEET_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#define FLEET_DEFAULT_BAUD  921600      // Data rate asked for; the board caps it (OTA_MAX_BAUD)
+#define FLEET_MAX_EVENTS    64
+
+// ==================== IMAGE ====================
+static bool loadImage(const char* path, bool raw, FleetImage* image) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) return false;
+  std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  if (bytes.empty()) return false;
+  
+  image->imageBytes = (uint32_t)bytes.size();
+  image->sha256 = sha256Hex(bytes.data(), bytes.size());
+  image->encoding = 'r';
+#if FLEET_HAVE_ZLIB
+  // Compressed once for the whole rack; the board inflates with the ROM's tinfl
+  if (!raw) {
+    uLongf len = compressBound(bytes.size());
+    std::vector<uint8_t> packed(len);
+    if (compress2(packed.data(), &len, bytes.data(), bytes.size(), 9) == Z_OK && len < bytes.size()) {
+      packed.resize(len);
+      image->wire.swap(packed);
+      image->encoding = 'z';
+      return true;
+    }
+  }
+#else
+  (void)raw;
+#endif
+  image->wire.swap(bytes);
+  return true;
+}
+
+// ==================== REPORT ====================
+static void printReport(const std::vector<Session>& sessions, const FleetImage& image, bool checkOnly,
+                        int64_t wallMs) {
+  printf("\n%-20s %-5s %4s %-6s %7s %7s %8s %8s %5s  %s\n",
+         "PORT", "FW", "SAFE", "SLOT", "BAUD", "PROBE", "FLASH", "BOARD", "KB/s", "RESULT");
+  int ok = 0;
+  uint64_t wireBytes = 0;
+  for (const Session& s : sessions) {
+    bool flashed = s.state == SESSION_DONE && !checkOnly;
+    if (s.state == SESSION_DONE) ok++;
+    if (flashed) wireBytes += image.wire.size();
+    
+    int64_t flashMs = (flashed && s.dataStartMs) ? s.doneMs - s.dataStartMs : 0;
+    unsigned long hostKBps = flashMs ? (unsigned long)(image.wire.size() / flashMs) : 0;
+    printf("%-20s %-5s %4ld %-6s %7u %5lldms %6lldms %6lums %5lu  %s\n",
+           s.path.c_str(), s.fw.empty() ? "-" : s.fw.c_str(), s.safePins, s.slot.empty() ? "-" : s.slot.c_str(),
+           s.baud, (long long)s.probeMs, (long long)flashMs, s.boardMs, hostKBps,
+           s.state == SESSION_DONE ? "OK" : s.error.c_str());
+  }
+  
+  printf("\nFLEET boards=%zu ok=%d failed=%zu wall_ms=%lld", sessions.size(), ok,
+         sessions.size() - ok, (long long)wallMs);
+  if (!checkOnly) {
+    printf(" image=%u wire=%zu enc=%c aggregate_kbps=%llu", image.imageBytes, image.wire.size(), image.encoding,
+           (unsigned long long)(wallMs ? wireBytes / wallMs : 0));
+  }
+  printf("\n");
+}
+
+// ==================== EVENT LOOP ====================
+static void updateInterest(int epollFd, Session& s, bool* polledOut) {
+  bool want = sessionWantsWrite(s);
+  if (want == *polledOut) return;
+  epoll_event ev = {};
+  ev.events = want ? (uint32_t)(EPOLLIN | EPOLLOUT) : (uint32_t)EPOLLIN;
+  ev.data.ptr = &s;
+  epoll_ctl(epollFd, EPOLL_CTL_MOD, s.fd, &ev);
+  *polledOut = want;
+}
+
+static void closeSession(int epollFd, Session& s) {
+  if (s.fd < 0) return;
+  epoll_ctl(epollFd, EPOLL_CTL_DEL, s.fd, nullptr);
+  close(s.fd);
+  s.fd = -1;
+}
+
+static void runSessions(std::vector<Session>& sessions, const FleetImage& image) {
+  int epollFd = epoll_create1(EPOLL_CLOEXEC);
+  std::vector<bool> polledOut(sessions.size(), false);
+  int active = 0;
+  int64_t now = nowMs();
+  for (Session& s : sessions) {
+    if (sessionFinished(s)) continue;
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.ptr = &s;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, s.fd, &ev);
+    startSession(s, now);
+    active++;
+  }
+  
+  while (active) {
+    int64_t next = INT64_MAX;
+    for (const Session& s : sessions) {
+      if (!sessionFinished(s) && s.deadlineMs < next) next = s.deadlineMs;
+    }
+    now = nowMs();
+    int timeout = next <= now ? 0 : (int)(next - now);
+    
+    epoll_event events[FLEET_MAX_EVENTS];
+    int n = epoll_wait(epollFd, events, FLEET_MAX_EVENTS, timeout);
+    now = nowMs();
+    for (int i = 0; i < n; i++) {
+      Session& s = *(Session*)events[i].data.ptr;
+      if (events[i].events & EPOLLOUT) sessionWritable(s);
+      if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) sessionReadable(s, image, now);
+    }
+    
+    for (size_t i = 0; i < sessions.size(); i++) {
+      Session& s = sessions[i];
+      if (s.fd < 0) continue;
+      if (!sessionFinished(s) && now >= s.deadlineMs) sessionTimeout(s, image, now);
+      if (sessionFinished(s)) {
+        closeSession(epollFd, s);
+        active--;
+        continue;
+      }
+      bool out = polledOut[i];
+      updateInterest(epollFd, s, &out);
+      polledOut[i] = out;
+    }
+  }
+  close(epollFd);
+}
+
+// ==================== MAIN ====================
+static void usage() {
+  fprintf(stderr,
+    "usage: fleetflash [--baud N] [--raw] <app.bin> <port>...\n"
+    "       fleetflash [--baud N] --check <port>...\n"
+    "  --baud N  data rate to ask each board for (default %d, capped by the board)\n"
+    "  --raw     send the image uncompressed\n"
+    "  --check   only confirm every board reports verified safe pins\n",
+    FLEET_DEFAULT_BAUD);
+}
+
+int main(int argc, char** argv) {
+  uint32_t baud = FLEET_DEFAULT_BAUD;
+  bool raw = false, checkOnly = false;
+  int arg = 1;
+  for (; arg < argc && argv[arg][0] == '-'; arg++) {
+    if (!strcmp(argv[arg], "--baud") && arg + 1 < argc) {
+      baud = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+    } else if (!strcmp(argv[arg], "--raw")) {
+      raw = true;
+    } else if (!strcmp(argv[arg], "--check")) {
+      checkOnly = true;
+    } else {
+      usage();
+      return 2;
+    }
+  }
+  
+  FleetImage image = {};
+  if (!checkOnly) {
+    if (arg >= argc) {
+      usage();
+      return 2;
+    }
+    if (!loadImage(argv[arg], raw, &image)) {
+      fprintf(stderr, "fleetflash: cannot read %s\n", argv[arg]);
+      return 2;
+    }
+    arg++;
+  }
+  if (arg >= argc) {
+    usage();
+    return 2;
+  }
+  
+  std::vector<Session> sessions(argc - arg);
+  for (size_t i = 0; i < sessions.size(); i++) {
+    Session& s = sessions[i];
+    s.path = argv[arg + i];
+    s.checkOnly = checkOnly;
+    s.requestBaud = baud;
+    std::string error;
+    s.fd = openSerialPort(s.path, FLEET_CONSOLE_BAUD, &error);
+    if (s.fd < 0) {
+      s.state = SESSION_FAILED;
+      s.error = error;
+    }
+  }
+  
+  int64_t start = nowMs();
+  runSessions(sessions, image);
+  printReport(sessions, image, checkOnly, nowMs() - start);
+  
+  for (const Session& s : sessions) {
+    if (s.state != SESSION_DONE) return 1;
+  }
+  return 0;
+}
\ No newline at end of file
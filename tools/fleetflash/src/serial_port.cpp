@@ -0,0 +1,66 @@
+/**
+ * Raw serial ports
+ * See src/serial_port.h
+ */
+
+#include "serial_port.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+static speed_t baudConstant(uint32_t baud) {
+  switch (baud) {
+    case 9600:    return B9600;
+    case 19200:   return B19200;
+    case 38400:   return B38400;
+    case 57600:   return B57600;
+    case 115200:  return B115200;
+    case 230400:  return B230400;
+    case 460800:  return B460800;
+    case 500000:  return B500000;
+    case 921600:  return B921600;
+    case 1000000: return B1000000;
+    case 1500000: return B1500000;
+    case 2000000: return B2000000;
+    default:      return 0;
+  }
+}
+
+bool setSerialBaud(int fd, uint32_t baud) {
+  speed_t speed = baudConstant(baud);
+  termios tio;
+  if (!speed || tcgetattr(fd, &tio) != 0) return false;
+  cfsetispeed(&tio, speed);
+  cfsetospeed(&tio, speed);
+  return tcsetattr(fd, TCSANOW, &tio) == 0;
+}
+
+int openSerialPort(const std::string& path, uint32_t baud, std::string* error) {
+  int fd = open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+  if (fd < 0) {
+    *error = strerror(errno);
+    return -1;
+  }
+  
+  termios tio;
+  if (tcgetattr(fd, &tio) != 0) {
+    *error = strerror(errno);
+    close(fd);
+    return -1;
+  }
+  cfmakeraw(&tio);
+  tio.c_cflag |= CLOCAL | CREAD;
+  tio.c_cflag &= ~(CRTSCTS | HUPCL);    // Dropping DTR/RTS on close would reset the board
+  tio.c_cc[VMIN] = 1;                   // With O_NONBLOCK: EAGAIN when empty, 0 only on hangup
+  tio.c_cc[VTIME] = 0;
+  if (tcsetattr(fd, TCSANOW, &tio) != 0 || !setSerialBaud(fd, baud)) {
+    *error = "cannot set " + std::to_string(baud) + " baud";
+    close(fd);
+    return -1;
+  }
+  tcflush(fd, TCIOFLUSH);                 // Banner noise from before we opened the port
+  return fd;
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+/**
+ * Raw serial ports
+ * Non-blocking 8N1, no flow control and no line discipline, so the epoll loop
+ * in main.cpp sees every byte the board sends as soon as it arrives.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// File descriptor, or -1 with *error set
+int openSerialPort(const std::string& path, uint32_t baud, std::string* error);
+
+// Switch a port that is already open; false for a rate termios cannot express
+bool setSerialBaud(int fd, uint32_t baud);
\ No newline at end of file
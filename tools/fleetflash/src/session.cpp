@@ -0,0 +1,227 @@
+/**
+ * One board's flashing session
+ * See src/session.h
+ */
+
+#include "session.h"
+#include "serial_port.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <unistd.h>
+
+static const char* const STATE_NAMES[] = {
+  "wake", "status frame", "OTA READY", "OTA GO", "baud switch", "chunk ack", "OTA result", "done", "failed"
+};
+
+int64_t nowMs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void fail(Session& s, const std::string& why, int64_t now) {
+  s.state = SESSION_FAILED;
+  s.error = why;
+  s.doneMs = now;
+}
+
+void sessionWritable(Session& s) {
+  while (s.outOff < s.out.size()) {
+    ssize_t n = write(s.fd, s.out.data() + s.outOff, s.out.size() - s.outOff);
+    if (n <= 0) return;                 // EAGAIN: epoll reports when there is room again
+    s.outOff += n;
+  }
+  s.out.clear();
+  s.outOff = 0;
+}
+
+static void send(Session& s, const void* data, size_t len) {
+  const uint8_t* bytes = (const uint8_t*)data;
+  s.out.insert(s.out.end(), bytes, bytes + len);
+  sessionWritable(s);
+}
+
+static void send(Session& s, const char* text) {
+  send(s, text, strlen(text));
+}
+
+static void expect(Session& s, SessionState state, int64_t now, int64_t timeoutMs) {
+  s.state = state;
+  s.deadlineMs = now + timeoutMs;
+}
+
+// The frame is flat enough that a key search beats a JSON parser
+static bool jsonNumber(const std::string& json, const char* key, long* value) {
+  size_t at = json.find(key);
+  if (at == std::string::npos) return false;
+  *value = strtol(json.c_str() + at + strlen(key), nullptr, 10);
+  return true;
+}
+
+static std::string jsonString(const std::string& json, const char* key) {
+  size_t at = json.find(key);
+  if (at == std::string::npos) return "";
+  at += strlen(key);
+  size_t end = json.find('"', at);
+  return end == std::string::npos ? "" : json.substr(at, end - at);
+}
+
+static void sendChunk(Session& s, const FleetImage& image, int64_t now) {
+  size_t len = image.wire.size() - s.sent;
+  if (len > s.chunk) len = s.chunk;
+  send(s, image.wire.data() + s.sent, len);
+  s.sent += len;
+  if (s.sent == image.wire.size()) {
+    expect(s, SESSION_RESULT, now, FLEET_RESULT_MS);   // No ack after the last chunk
+  } else {
+    expect(s, SESSION_DATA, now, FLEET_ACK_MS);
+  }
+}
+
+static void statusFrame(Session& s, const std::string& frame, int64_t now) {
+  long verified = 0;
+  s.fw = jsonString(frame, "\"fw\":\"");
+  jsonNumber(frame, "\"pins\":{\"safe\":", &s.safePins);
+  if (!jsonNumber(frame, "\"verify\":{\"ok\":", &verified) || !verified) {
+    fail(s, "pins do not verify as secured", now);
+    return;
+  }
+  s.probeMs = now - s.startMs;
+  if (s.checkOnly) {
+    s.state = SESSION_DONE;
+    s.doneMs = now;
+    return;
+  }
+  send(s, "u");
+  expect(s, SESSION_READY, now, FLEET_REPLY_MS);
+}
+
+static void otaReady(Session& s, const std::string& line, const FleetImage& image, int64_t now) {
+  char slot[32] = "";
+  unsigned long slotBytes = 0, maxBaud = 0, chunk = 0;
+  if (sscanf(line.c_str(), "OTA READY %31s %lu %lu %lu", slot, &slotBytes, &maxBaud, &chunk) != 4 || !chunk) {
+    fail(s, "bad OTA READY line", now);
+    return;
+  }
+  s.slot = slot;
+  s.chunk = chunk;
+  if (image.imageBytes > slotBytes) {
+    fail(s, "image does not fit " + s.slot, now);
+    send(s, "0 0 r\n");                 // A header the receiver refuses: back to the console now
+    return;
+  }
+  
+  uint32_t baud = maxBaud ? (s.requestBaud < maxBaud ? s.requestBaud : (uint32_t)maxBaud) : 0;
+  char header[160];
+  snprintf(header, sizeof(header), "%u %zu %c %u %s\n", image.imageBytes, image.wire.size(),
+           image.encoding, baud, image.sha256.c_str());
+  send(s, header);
+  expect(s, SESSION_GO, now, FLEET_REPLY_MS);
+}
+
+static void otaGo(Session& s, const std::string& line, int64_t now) {
+  unsigned long baud = 0;
+  if (sscanf(line.c_str(), "OTA GO %lu", &baud) != 1) {
+    fail(s, "bad OTA GO line", now);
+    return;
+  }
+  s.baud = baud;
+  if (baud && baud != FLEET_CONSOLE_BAUD && !setSerialBaud(s.fd, baud)) {
+    fail(s, "host cannot run " + std::to_string(baud) + " baud", now);
+    return;
+  }
+  expect(s, SESSION_SETTLE, now, FLEET_SETTLE_MS);
+}
+
+static void otaResult(Session& s, const std::string& line, int64_t now) {
+  unsigned long bytes = 0;
+  if (sscanf(line.c_str(), "OTA OK %lu %lu %lu", &bytes, &s.boardMs, &s.boardKBps) == 3) {
+    s.state = SESSION_DONE;
+    s.doneMs = now;
+  } else {
+    fail(s, line, now);
+  }
+}
+
+static void onLine(Session& s, const std::string& line, const FleetImage& image, int64_t now) {
+  bool otaFail = line.compare(0, 8, "OTA FAIL") == 0;
+  switch (s.state) {
+    case SESSION_PROBE:
+      if (line.compare(0, 6, "{\"fw\":") == 0) statusFrame(s, line, now);
+      break;
+    case SESSION_READY:
+      if (line.compare(0, 9, "OTA READY") == 0) otaReady(s, line, image, now);
+      else if (otaFail) fail(s, line, now);
+      break;
+    case SESSION_GO:
+      if (line.compare(0, 6, "OTA GO") == 0) otaGo(s, line, now);
+      else if (otaFail) fail(s, line, now);
+      break;
+    case SESSION_RESULT:
+      if (otaFail || line.compare(0, 6, "OTA OK") == 0) otaResult(s, line, now);
+      break;
+    default:
+      break;                            // Log lines and banner noise
+  }
+}
+
+void sessionReadable(Session& s, const FleetImage& image, int64_t now) {
+  uint8_t buffer[4096];
+  while (!sessionFinished(s)) {
+    ssize_t n = read(s.fd, buffer, sizeof(buffer));
+    if (n <= 0) {
+      if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) fail(s, "port closed", now);
+      return;
+    }
+  
+    for (ssize_t i = 0; i < n && !sessionFinished(s); i++) {
+      char c = (char)buffer[i];
+      if (s.state == SESSION_DATA) {    // Single-byte acks, no line framing
+        if (c == '.') sendChunk(s, image, now);
+        else if (c == 'E') expect(s, SESSION_RESULT, now, FLEET_REPLY_MS);
+        continue;
+      }
+      if (c == '\n') {
+        if (!s.line.empty() && s.line.back() == '\r') s.line.pop_back();
+        onLine(s, s.line, image, now);
+        s.line.clear();
+      } else if (s.line.size() < FLEET_LINE_MAX) {
+        s.line += c;
+      }
+    }
+  }
+}
+
+void startSession(Session& s, int64_t now) {
+  s.startMs = now;
+  send(s, "\n");
+  expect(s, SESSION_WAKE, now, FLEET_WAKE_MS);
+}
+
+void sessionTimeout(Session& s, const FleetImage& image, int64_t now) {
+  switch (s.state) {
+    case SESSION_WAKE:
+      send(s, "j");
+      expect(s, SESSION_PROBE, now, FLEET_PROBE_MS);
+      break;
+    case SESSION_PROBE:
+      if (++s.probeTries < FLEET_PROBE_TRIES) {
+        send(s, "\n");                  // Maybe asleep again, or the editor ate the byte
+        expect(s, SESSION_WAKE, now, FLEET_WAKE_MS);
+      } else {
+        fail(s, "no status frame", now);
+      }
+      break;
+    case SESSION_SETTLE:
+      s.dataStartMs = now;
+      sendChunk(s, image, now);
+      break;
+    default:
+      fail(s, std::string("timeout waiting for ") + STATE_NAMES[s.state], now);
+      break;
+  }
+}
\ No newline at end of file
@@ -0,0 +1,90 @@
+/**
+ * One board's flashing session
+ * A state machine fed by the epoll loop in main.cpp. It wakes the board out of
+ * idle light sleep, asks for the JSON status frame ('j') and only continues when
+ * the frame reports verified pins. Then it drives the streaming receiver ('u',
+ * see the Firmware Receive section of the README) one acknowledged chunk at a
+ * time. Nothing blocks, so every board in the rack advances on its own ack
+ * clock.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define FLEET_CONSOLE_BAUD  115200      // Safe-mode console rate (SERIAL_BAUD)
+#define FLEET_WAKE_MS       100         // The byte that wakes the chip is consumed; wait before 'j'
+#define FLEET_PROBE_MS      2000        // Status frame after 'j'
+#define FLEET_PROBE_TRIES   3
+#define FLEET_REPLY_MS      3000        // OTA READY and OTA GO (the receiver's OTA_TIMEOUT_MS)
+#define FLEET_SETTLE_MS     20          // Board flushes, then switches baud after OTA GO
+#define FLEET_ACK_MS        15000       // Per chunk, flash erase included
+#define FLEET_RESULT_MS     20000       // Last chunk to OTA OK: SHA-256 and image check
+#define FLEET_LINE_MAX      2048
+
+// The image as sent, shared by every session
+struct FleetImage {
+  std::vector<uint8_t> wire;            // zlib stream or raw image
+  uint32_t imageBytes;                  // Before compression
+  char encoding;                        // 'z' (zlib) or 'r' (raw)
+  std::string sha256;                   // Of the uncompressed image, hex
+};
+
+enum SessionState : uint8_t {
+  SESSION_WAKE,                         // Newline sent, waiting out the wake byte
+  SESSION_PROBE,                        // 'j' sent, waiting for the status frame
+  SESSION_READY,                        // 'u' sent, waiting for OTA READY
+  SESSION_GO,                           // Header sent, waiting for OTA GO
+  SESSION_SETTLE,                       // Baud switched, waiting for the board to follow
+  SESSION_DATA,                         // Chunk sent, waiting for '.' or 'E'
+  SESSION_RESULT,                       // Waiting for OTA OK / OTA FAIL
+  SESSION_DONE,
+  SESSION_FAILED
+};
+
+struct Session {
+  std::string path;
+  int fd = -1;
+  SessionState state = SESSION_WAKE;
+  int64_t deadlineMs = 0;
+  int probeTries = 0;
+  bool checkOnly = false;               // Stop after the status frame
+  uint32_t requestBaud = FLEET_CONSOLE_BAUD;
+  
+  std::string line;                     // Partial line from the board
+  std::vector<uint8_t> out;             // Not yet accepted by the kernel
+  size_t outOff = 0;
+  size_t sent = 0;                      // Wire bytes queued so far
+  uint32_t chunk = 0;                   // From OTA READY
+  
+  // Results
+  std::string fw;
+  long safePins = -1;
+  std::string slot;
+  uint32_t baud = 0;                    // Data rate, 0 on USB-CDC
+  int64_t startMs = 0;
+  int64_t probeMs = 0;                  // Open to verified status frame
+  int64_t dataStartMs = 0;
+  int64_t doneMs = 0;
+  unsigned long boardMs = 0;            // As reported by OTA OK
+  unsigned long boardKBps = 0;
+  std::string error;
+};
+
+int64_t nowMs();
+
+void startSession(Session& s, int64_t now);
+void sessionReadable(Session& s, const FleetImage& image, int64_t now);
+void sessionWritable(Session& s);
+void sessionTimeout(Session& s, const FleetImage& image, int64_t now);
+
+inline bool sessionFinished(const Session& s) {
+  return s.state == SESSION_DONE || s.state == SESSION_FAILED;
+}
+
+inline bool sessionWantsWrite(const Session& s) {
+  return s.outOff < s.out.size();
+}
\ No newline at end of file
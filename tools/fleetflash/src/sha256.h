@@ -0,0 +1,13 @@
+/**
+ * SHA-256 (FIPS 180-4)
+ * The receiver checks the inflated image against this digest before it
+ * switches the boot partition, so the host hashes the image it read from disk.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+std::string sha256Hex(const uint8_t* data, size_t len);
\ No newline at end of file